@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <parquet/api/reader.h>
+
+/*
+ * Reading a column's values the same way in parquet-diff and parquet-hash,
+ * so both tools agree on which files are equal.
+ */
+
+
+/**
+ * Reads one column of a whole file, row group after row group, as though it
+ * were one column chunk.
+ *
+ * ReadBatch() works like parquet::TypedColumnReader::ReadBatch(), so
+ * templates that read one (such as BatchedChunkReader) can read the other.
+ */
+template <typename DType>
+class ColumnStream {
+  parquet::ParquetFileReader& file;
+  int columnNumber;
+  int nextRowGroup;
+  std::shared_ptr<parquet::RowGroupReader> rowGroup;
+  std::shared_ptr<parquet::TypedColumnReader<DType>> chunk; // nullptr before the first row group
+
+public:
+  ColumnStream(parquet::ParquetFileReader& file_, int columnNumber_)
+    : file(file_)
+    , columnNumber(columnNumber_)
+    , nextRowGroup(0)
+  {
+  }
+
+  /**
+   * Read up to `batchSize` levels (and their values) from the current row
+   * group, moving on to the next row group when this one is done.
+   *
+   * A batch never spans two row groups, so ByteArray values stay valid
+   * until the next call. Return 0 at the end of the file.
+   */
+  int64_t ReadBatch(int64_t batchSize, int16_t* defLevels, int16_t* repLevels, typename DType::c_type* values, int64_t* valuesRead) {
+    while (true) {
+      if (this->chunk) {
+        const int64_t n = this->chunk->ReadBatch(batchSize, defLevels, repLevels, values, valuesRead);
+        if (n > 0) {
+          return n;
+        }
+      }
+      if (this->nextRowGroup == this->file.metadata()->num_row_groups()) {
+        *valuesRead = 0;
+        return 0;
+      }
+      this->openNextRowGroup();
+    }
+  }
+
+  /**
+   * Skip the first `nRows` rows of a flat column. Call before ReadBatch().
+   *
+   * We never read row groups we skip entirely: their sizes are in the
+   * file's metadata. Return the number of rows skipped.
+   */
+  int64_t Skip(int64_t nRows) {
+    const parquet::FileMetaData& metadata = *this->file.metadata();
+    int64_t nSkipped = 0;
+    while (this->nextRowGroup < metadata.num_row_groups() && nRows - nSkipped >= metadata.RowGroup(this->nextRowGroup)->num_rows()) {
+      nSkipped += metadata.RowGroup(this->nextRowGroup)->num_rows();
+      this->nextRowGroup++;
+    }
+    if (nSkipped < nRows && this->nextRowGroup < metadata.num_row_groups()) {
+      this->openNextRowGroup();
+      nSkipped += this->chunk->Skip(nRows - nSkipped);
+    }
+    return nSkipped;
+  }
+
+private:
+  void openNextRowGroup() {
+    this->rowGroup = this->file.RowGroup(this->nextRowGroup);
+    this->chunk = std::static_pointer_cast<parquet::TypedColumnReader<DType>>(this->rowGroup->Column(this->columnNumber));
+    this->nextRowGroup++;
+  }
+};
+
+
+/**
+ * Reads a column chunk (or ColumnStream) in fixed-size batches, one value at
+ * a time.
+ *
+ * Values (including ByteArray pointers) stay valid until the next call to
+ * next() refills the batch.
+ */
+template <typename DType, typename Chunk>
+class BatchedChunkReader {
+  static const int kBatchSize = 1024;
+
+  Chunk& chunk;
+  std::array<typename DType::c_type, kBatchSize> values; // nulls not included
+  std::array<int16_t, kBatchSize> valid; // 1 = there is a value; 0 = skipped a value
+  int64_t batchSize;
+  int64_t validCursor;
+  int64_t valueCursor;
+
+public:
+  BatchedChunkReader(Chunk& chunk_)
+    : chunk(chunk_)
+    , batchSize(0)
+    , validCursor(0)
+    , valueCursor(0)
+  {
+  }
+
+  /**
+   * Return the next value, or nullptr if it is null.
+   *
+   * Throw if the chunk has no more values.
+   */
+  const typename DType::c_type* next() {
+    if (this->validCursor == this->batchSize) {
+      int64_t nValues;
+      this->batchSize = this->chunk.ReadBatch(kBatchSize, &this->valid[0], nullptr, &this->values[0], &nValues);
+      this->validCursor = 0;
+      this->valueCursor = 0;
+      if (this->batchSize == 0) {
+        throw std::runtime_error("Parquet column chunk has fewer values than its row group");
+      }
+      if (nValues == this->batchSize) {
+        // No nulls. (A required column has no definition levels, so
+        // ReadBatch() didn't write them.)
+        std::fill(&this->valid[0], &this->valid[this->batchSize], 1);
+      }
+    }
+
+    const typename DType::c_type* ret = nullptr;
+    if (this->valid[this->validCursor]) {
+      ret = &this->values[this->valueCursor];
+      this->valueCursor++;
+    }
+    this->validCursor++;
+    return ret;
+  }
+};
+
+
+/**
+ * Append a value's encoding to `out`: fixed-width values as their bytes
+ * (with -0.0 as 0.0, since they're equal), byte arrays as a uint32_t length
+ * and their bytes.
+ */
+template <typename CType>
+static inline void appendValue(std::string& out, const CType& value) {
+  if constexpr (std::is_same<CType, parquet::ByteArray>::value) {
+    const uint32_t len = value.len;
+    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    out.append(reinterpret_cast<const char*>(value.ptr), len);
+  } else if constexpr (std::is_floating_point<CType>::value) {
+    const CType canonical = value == 0 ? 0 : value; // -0.0 equals 0.0
+    out.append(reinterpret_cast<const char*>(&canonical), sizeof(canonical));
+  } else {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(CType));
+  }
+}
+
+
+/**
+ * Appends one column's cells, row after row, to byte strings (for --key).
+ *
+ * Each cell is a 0 byte (null) or a 1 byte and the value: fixed-width values
+ * as their bytes, byte arrays as a uint32_t length and their bytes. Cells
+ * are equal iff their encodings are, and a row's cells can be concatenated
+ * and split apart again.
+ */
+class CellEncoder {
+public:
+  virtual ~CellEncoder() {}
+
+  /**
+   * Append the next cell to `out`.
+   *
+   * Throw if the column has no more values.
+   */
+  virtual void appendNext(std::string& out) = 0;
+};
+
+
+template <typename DType>
+class TypedCellEncoder : public CellEncoder {
+  typedef typename DType::c_type CType;
+
+  ColumnStream<DType> stream;
+  BatchedChunkReader<DType, ColumnStream<DType>> reader;
+
+public:
+  TypedCellEncoder(parquet::ParquetFileReader& file, int columnNumber)
+    : stream(file, columnNumber)
+    , reader(this->stream)
+  {
+  }
+
+  void appendNext(std::string& out) override {
+    const CType* value = this->reader.next();
+    if (!value) {
+      out.push_back('\0');
+      return;
+    }
+
+    out.push_back('\1');
+    appendValue(out, *value);
+  }
+};
+
+
+static inline std::unique_ptr<CellEncoder> makeCellEncoder(parquet::ParquetFileReader& file, int columnNumber) {
+  switch (file.metadata()->schema()->Column(columnNumber)->physical_type()) {
+    case parquet::Type::INT32: return std::make_unique<TypedCellEncoder<parquet::Int32Type>>(file, columnNumber);
+    case parquet::Type::INT64: return std::make_unique<TypedCellEncoder<parquet::Int64Type>>(file, columnNumber);
+    case parquet::Type::FLOAT: return std::make_unique<TypedCellEncoder<parquet::FloatType>>(file, columnNumber);
+    case parquet::Type::DOUBLE: return std::make_unique<TypedCellEncoder<parquet::DoubleType>>(file, columnNumber);
+    case parquet::Type::BYTE_ARRAY: return std::make_unique<TypedCellEncoder<parquet::ByteArrayType>>(file, columnNumber);
+    default:
+      throw std::runtime_error("Column " + std::to_string(columnNumber) + ": unhandled physical data type");
+  }
+}
+
+
+/**
+ * Appends a nested column's items to byte strings, a batch at a time (for
+ * parquet-hash).
+ *
+ * Each item is its definition level and repetition level (int16_t each),
+ * then, if it's fully defined, its value as appendValue() writes it. Two
+ * columns' encodings are equal iff parquet-diff finds their level streams
+ * and values equal.
+ */
+class LevelEncoder {
+public:
+  virtual ~LevelEncoder() {}
+
+  /**
+   * Append the next batch of items to `out`. Return false at the end of the
+   * column.
+   */
+  virtual bool appendNextBatch(std::string& out) = 0;
+};
+
+
+template <typename DType>
+class TypedLevelEncoder : public LevelEncoder {
+  static const int kBatchSize = 1024;
+
+  ColumnStream<DType> stream;
+  const int16_t maxDefinitionLevel;
+  std::vector<int16_t> defLevels;
+  std::vector<int16_t> repLevels;
+  std::vector<typename DType::c_type> values;
+
+public:
+  TypedLevelEncoder(parquet::ParquetFileReader& file, int columnNumber)
+    : stream(file, columnNumber)
+    , maxDefinitionLevel(file.metadata()->schema()->Column(columnNumber)->max_definition_level())
+    , defLevels(kBatchSize)
+    , repLevels(kBatchSize, 0) // stay 0 if the column doesn't repeat
+    , values(kBatchSize)
+  {
+  }
+
+  bool appendNextBatch(std::string& out) override {
+    int64_t nValues;
+    const int64_t n = this->stream.ReadBatch(kBatchSize, &this->defLevels[0], &this->repLevels[0], &this->values[0], &nValues);
+    for (int64_t i = 0, value = 0; i < n; i++) {
+      out.append(reinterpret_cast<const char*>(&this->defLevels[i]), sizeof(int16_t));
+      out.append(reinterpret_cast<const char*>(&this->repLevels[i]), sizeof(int16_t));
+      if (this->defLevels[i] == this->maxDefinitionLevel) {
+        appendValue(out, this->values[value++]);
+      }
+    }
+    return n > 0;
+  }
+};
+
+
+static inline std::unique_ptr<LevelEncoder> makeLevelEncoder(parquet::ParquetFileReader& file, int columnNumber) {
+  switch (file.metadata()->schema()->Column(columnNumber)->physical_type()) {
+    case parquet::Type::INT32: return std::make_unique<TypedLevelEncoder<parquet::Int32Type>>(file, columnNumber);
+    case parquet::Type::INT64: return std::make_unique<TypedLevelEncoder<parquet::Int64Type>>(file, columnNumber);
+    case parquet::Type::FLOAT: return std::make_unique<TypedLevelEncoder<parquet::FloatType>>(file, columnNumber);
+    case parquet::Type::DOUBLE: return std::make_unique<TypedLevelEncoder<parquet::DoubleType>>(file, columnNumber);
+    case parquet::Type::BYTE_ARRAY: return std::make_unique<TypedLevelEncoder<parquet::ByteArrayType>>(file, columnNumber);
+    default:
+      throw std::runtime_error("Column " + std::to_string(columnNumber) + ": unhandled physical data type");
+  }
+}
+
+
+/**
+ * Return the size of the CellEncoder cell at the start of `cells`.
+ */
+static inline size_t cellSize(parquet::Type::type physicalType, std::string_view cells) {
+  if (cells[0] == '\0') return 1;
+  switch (physicalType) {
+    case parquet::Type::INT32: return 1 + sizeof(int32_t);
+    case parquet::Type::INT64: return 1 + sizeof(int64_t);
+    case parquet::Type::FLOAT: return 1 + sizeof(float);
+    case parquet::Type::DOUBLE: return 1 + sizeof(double);
+    default:
+      {
+        uint32_t len;
+        std::memcpy(&len, cells.data() + 1, sizeof(len));
+        return 1 + sizeof(len) + len;
+      }
+  }
+}
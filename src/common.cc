@@ -1,8 +1,13 @@
 #include <algorithm>
+#include <cstdlib>
 #include <memory>
+#include <string>
+#include <unistd.h>
 #include <arrow/array/concatenate.h>
 #include <arrow/io/api.h>
 #include <arrow/ipc/api.h>
+#include <parquet/exception.h>
+#include <parquet/properties.h>
 
 #include "common.h"
 
@@ -14,11 +19,11 @@ std::shared_ptr<arrow::Array> chunkedArrayToArray(const arrow::ChunkedArray& inp
         std::shared_ptr<arrow::DataType> type(input.type());
         std::unique_ptr<arrow::ArrayBuilder> builder;
         std::shared_ptr<arrow::Array> output;
-        ASSERT_ARROW_OK(
+        THROW_UNLESS_ARROW_OK(
             arrow::MakeBuilder(arrow::default_memory_pool(), type, &builder),
             "make zero-length array builder"
         );
-        ASSERT_ARROW_OK(
+        THROW_UNLESS_ARROW_OK(
             builder->Finish(&output),
             "build zero-length array"
         );
@@ -28,7 +33,7 @@ std::shared_ptr<arrow::Array> chunkedArrayToArray(const arrow::ChunkedArray& inp
         return input.chunk(0);
     } else {
         // Input has more than one chunk; concatenate them
-        return ASSERT_ARROW_OK(
+        return THROW_UNLESS_ARROW_OK(
             arrow::Concatenate(input.chunks(), arrow::default_memory_pool()),
             "concatenating chunks"
         );
@@ -37,11 +42,11 @@ std::shared_ptr<arrow::Array> chunkedArrayToArray(const arrow::ChunkedArray& inp
 
 void writeArrowTable(const arrow::Table& arrowTable, const std::string& path)
 {
-  std::shared_ptr<arrow::io::FileOutputStream> outputStream(ASSERT_ARROW_OK(
+  std::shared_ptr<arrow::io::FileOutputStream> outputStream(THROW_UNLESS_ARROW_OK(
       arrow::io::FileOutputStream::Open(path),
       "opening output stream"
   ));
-  std::shared_ptr<arrow::ipc::RecordBatchWriter> fileWriter(ASSERT_ARROW_OK(
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> fileWriter(THROW_UNLESS_ARROW_OK(
       arrow::ipc::MakeFileWriter(
           outputStream.get(),
           arrowTable.schema(),
@@ -52,7 +57,44 @@ void writeArrowTable(const arrow::Table& arrowTable, const std::string& path)
       ),
       "opening output file"
   ));
-  ASSERT_ARROW_OK(fileWriter->WriteTable(arrowTable), "writing Arrow table");
-  ASSERT_ARROW_OK(fileWriter->Close(), "closing Arrow file writer");
-  ASSERT_ARROW_OK(outputStream->Close(), "closing Arrow file");
+  THROW_UNLESS_ARROW_OK(fileWriter->WriteTable(arrowTable), "writing Arrow table");
+  THROW_UNLESS_ARROW_OK(fileWriter->Close(), "closing Arrow file writer");
+  THROW_UNLESS_ARROW_OK(outputStream->Close(), "closing Arrow file");
+}
+
+int openTemporaryFile()
+{
+  const char* tmpdir = std::getenv("TMPDIR");
+  std::string path = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/parquet-tmp-XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd != -1) {
+    unlink(path.c_str()); // the kernel deletes the file when we close it
+  }
+  return fd;
+}
+
+std::shared_ptr<arrow::io::RandomAccessFile> openParquetInput(const std::string& path, const ReaderOptions& options)
+{
+  std::shared_ptr<arrow::io::RandomAccessFile> file;
+  if (options.mmap) {
+    PARQUET_ASSIGN_OR_THROW(file, arrow::io::MemoryMappedFile::Open(path, arrow::io::FileMode::READ));
+  } else {
+    PARQUET_ASSIGN_OR_THROW(file, arrow::io::ReadableFile::Open(path));
+  }
+  return file;
+}
+
+std::unique_ptr<parquet::ParquetFileReader> openParquet(std::shared_ptr<arrow::io::RandomAccessFile> file, const ReaderOptions& options)
+{
+  parquet::ReaderProperties properties(parquet::default_reader_properties());
+  if (options.bufferedStream) {
+    properties.enable_buffered_stream();
+    properties.set_buffer_size(options.bufferSize);
+  }
+  return parquet::ParquetFileReader::Open(file, properties);
+}
+
+std::unique_ptr<parquet::ParquetFileReader> openParquet(const std::string& path, const ReaderOptions& options)
+{
+  return openParquet(openParquetInput(path, options), options);
 }
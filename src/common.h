@@ -1,24 +1,70 @@
-#include <cstdlib>
-#include <iostream>
 #include <memory>
+#include <stdexcept>
+#include <string>
 #include <arrow/api.h>
+#include <arrow/io/interfaces.h>
+#include <parquet/file_reader.h>
 
 
-static inline void ASSERT_ARROW_OK(arrow::Status status, const char* message)
+/**
+ * Throw std::runtime_error("Failure <message>: <status>") unless `status` is
+ * OK. We throw rather than exit, because parquet-tools.h runs our code inside
+ * other programs.
+ */
+static inline void THROW_UNLESS_ARROW_OK(arrow::Status status, const char* message)
 {
   if (!status.ok()) {
-    std::cerr << "Failure " << message << ": " << status.ToString() << std::endl;
-    std::_Exit(1);
+    throw std::runtime_error(std::string("Failure ") + message + ": " + status.ToString());
   }
 }
 
 template <typename T>
-static inline T ASSERT_ARROW_OK(arrow::Result<T> result, const char* message)
+static inline T THROW_UNLESS_ARROW_OK(arrow::Result<T> result, const char* message)
 {
-  ASSERT_ARROW_OK(result.status(), message);
+  THROW_UNLESS_ARROW_OK(result.status(), message);
   return result.ValueOrDie(); // TODO next version of Arrow has ValueUnsafe()
 }
 
 
 std::shared_ptr<arrow::Array> chunkedArrayToArray(const arrow::ChunkedArray& input);
 void writeArrowTable(const arrow::Table& arrowTable, const std::string& path);
+
+/**
+ * Create an already-unlinked temporary file in $TMPDIR (default /tmp).
+ *
+ * Return its file descriptor, or -1 (and set errno).
+ */
+int openTemporaryFile();
+
+/**
+ * How to read a Parquet file. Binaries set these with --mmap,
+ * --buffered-stream and --buffer-size (see reader-flags.h).
+ */
+struct ReaderOptions {
+  bool mmap = false; // memory-map the file, instead of reading it with pread()
+  bool bufferedStream = false; // read column chunks bufferSize bytes at a time, not whole
+  int64_t bufferSize = 16 * 1024;
+};
+
+/**
+ * Open a Parquet file for reading: memory-mapped, or read with pread().
+ *
+ * Throw parquet::ParquetException if we can't open it.
+ */
+std::shared_ptr<arrow::io::RandomAccessFile> openParquetInput(const std::string& path, const ReaderOptions& options);
+
+/**
+ * Parse a Parquet file's footer, and return a reader that reads column chunks
+ * whole or in buffered pieces, as `options` say.
+ *
+ * Pass the result of openParquetInput(), or a wrapper around it (such as a
+ * PrefetchingFile).
+ *
+ * Throw parquet::ParquetException if it isn't a valid Parquet file.
+ */
+std::unique_ptr<parquet::ParquetFileReader> openParquet(std::shared_ptr<arrow::io::RandomAccessFile> file, const ReaderOptions& options);
+
+/**
+ * Open a Parquet file: openParquet(openParquetInput(path, options), options).
+ */
+std::unique_ptr<parquet::ParquetFileReader> openParquet(const std::string& path, const ReaderOptions& options);
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "dictionary-budget.h"
+
+
+DictionaryBuffer::DictionaryBuffer(DictionaryBuffer&& other)
+  : budget(other.budget)
+  , bytes(other.bytes)
+  , size(other.size)
+  , spilled(other.spilled)
+{
+  other.budget = nullptr;
+  other.bytes = nullptr;
+  other.size = 0;
+}
+
+DictionaryBuffer&
+DictionaryBuffer::operator=(DictionaryBuffer&& other)
+{
+  if (this != &other) {
+    this->release();
+    std::swap(this->budget, other.budget);
+    std::swap(this->bytes, other.bytes);
+    std::swap(this->size, other.size);
+    std::swap(this->spilled, other.spilled);
+  }
+  return *this;
+}
+
+void
+DictionaryBuffer::release()
+{
+  if (this->budget) {
+    this->budget->free(*this);
+    this->budget = nullptr;
+    this->bytes = nullptr;
+    this->size = 0;
+  }
+}
+
+
+DictionaryBudget::DictionaryBudget(int64_t maxBytes_)
+  : maxBytes(maxBytes_)
+  , heldHeap(0)
+  , heldSpilled(0)
+  , peakHeap(0)
+  , peakSpilled(0)
+{
+}
+
+static uint8_t*
+mapTemporaryFile(size_t size)
+{
+  int fd = openTemporaryFile();
+  if (fd == -1) return nullptr;
+
+  void* addr = MAP_FAILED;
+  if (ftruncate(fd, size) == 0) {
+    addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd); // the mapping holds its own reference
+  return addr == MAP_FAILED ? nullptr : static_cast<uint8_t*>(addr);
+}
+
+DictionaryBuffer
+DictionaryBudget::allocate(size_t size)
+{
+  DictionaryBuffer buffer;
+  buffer.size = std::max(size, static_cast<size_t>(1)); // mmap() rejects 0 bytes
+
+  if (this->maxBytes < 0 || this->heldHeap + static_cast<int64_t>(buffer.size) <= this->maxBytes) {
+    buffer.bytes = static_cast<uint8_t*>(std::malloc(buffer.size));
+    buffer.spilled = false;
+    this->heldHeap += buffer.size;
+    this->peakHeap = std::max(this->peakHeap, this->heldHeap);
+  } else {
+    buffer.bytes = mapTemporaryFile(buffer.size);
+    buffer.spilled = true;
+    this->heldSpilled += buffer.size;
+    this->peakSpilled = std::max(this->peakSpilled, this->heldSpilled);
+  }
+
+  if (!buffer.bytes) {
+    throw std::runtime_error(std::string("Failed to allocate ") + std::to_string(buffer.size) + "-byte dictionary: " + std::strerror(errno));
+  }
+
+  buffer.budget = this;
+  return buffer;
+}
+
+void
+DictionaryBudget::free(DictionaryBuffer& buffer)
+{
+  if (buffer.spilled) {
+    munmap(buffer.bytes, buffer.size);
+    this->heldSpilled -= buffer.size;
+  } else {
+    std::free(buffer.bytes);
+    this->heldHeap -= buffer.size;
+  }
+}
@@ -0,0 +1,73 @@
+#include <cstddef>
+#include <cstdint>
+
+class DictionaryBudget;
+
+/**
+ * Storage for one column chunk's dictionary.
+ *
+ * It lives either on the heap or -- when the DictionaryBudget is spent -- in
+ * an mmap()-ed, already-unlinked temporary file. The kernel can evict the
+ * file's pages under memory pressure and fault them back in when a dictionary
+ * index refers to them: that is, the dictionary is paged in lazily.
+ *
+ * Move-only. Destroying it returns its bytes to the budget.
+ */
+class DictionaryBuffer {
+public:
+  DictionaryBuffer() : budget(nullptr), bytes(nullptr), size(0), spilled(false) {}
+  DictionaryBuffer(DictionaryBuffer&& other);
+  DictionaryBuffer& operator=(DictionaryBuffer&& other);
+  DictionaryBuffer(const DictionaryBuffer&) = delete;
+  DictionaryBuffer& operator=(const DictionaryBuffer&) = delete;
+  ~DictionaryBuffer() { this->release(); }
+
+  uint8_t* data() const { return this->bytes; }
+
+private:
+  friend class DictionaryBudget;
+
+  DictionaryBudget* budget;
+  uint8_t* bytes;
+  size_t size;
+  bool spilled; // true => bytes are mmap()-ed
+
+  void release();
+};
+
+/**
+ * Caps the dictionary bytes we hold in RAM, across all columns.
+ *
+ * Each column holds the dictionary of its current row group. Usually that's
+ * tiny; but a high-cardinality column can have a dictionary page of hundreds
+ * of megabytes, and we hold one per column. allocate() hands out heap memory
+ * while we're within budget and spills to disk beyond it.
+ */
+class DictionaryBudget {
+public:
+  /**
+   * Create a budget of `maxBytes` heap bytes. (Negative means no limit.)
+   */
+  DictionaryBudget(int64_t maxBytes);
+
+  /**
+   * Allocate `size` bytes for a dictionary.
+   *
+   * Throw std::runtime_error if we cannot allocate (or spill) them.
+   */
+  DictionaryBuffer allocate(size_t size);
+
+  int64_t peakHeapBytes() const { return this->peakHeap; }
+  int64_t peakSpilledBytes() const { return this->peakSpilled; }
+
+private:
+  friend class DictionaryBuffer;
+
+  const int64_t maxBytes;
+  int64_t heldHeap;
+  int64_t heldSpilled;
+  int64_t peakHeap;
+  int64_t peakSpilled;
+
+  void free(DictionaryBuffer& buffer);
+};
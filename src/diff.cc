@@ -0,0 +1,2231 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/reader.h>
+#include <double-conversion/double-conversion.h> // already a dep of arrow; and printf won't do
+#include <parquet/api/reader.h>
+#include <parquet/api/schema.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/arrow/schema.h>
+#include <parquet/exception.h>
+
+#include "column-iterator.h"
+#include "column-stream.h"
+#include "common.h"
+#include "diff.h"
+#include "hash-partition.h"
+#include "range.h"
+
+
+/**
+ * While comparing a chunk, check this often whether another thread found an
+ * earlier difference (which makes our answer moot).
+ */
+static const int64_t kRowsPerStopCheck = 65536;
+
+
+/**
+ * Compare fixed-width values this many rows at a time. (kRowsPerStopCheck
+ * is a multiple of it, so we check for cancellation on batch boundaries.)
+ */
+static const int64_t kCompareBatchSize = 4096;
+
+
+/**
+ * Return true if a column's values can be null at more than one level, or
+ * repeat: that is, if it has lists or structs.
+ */
+static bool
+isNested(const parquet::ColumnDescriptor& column)
+{
+  return column.max_definition_level() > 1 || column.max_repetition_level() > 0;
+}
+
+
+int diffColumn(int columnNumber, const parquet::ColumnDescriptor& column1, const parquet::ColumnDescriptor& column2, std::ostream& out) {
+  if (column1.name() != column2.name()) {
+    out
+      << "Column " << columnNumber << " name:" << std::endl
+      << "-" << column1.name() << std::endl
+      << "+" << column2.name() << std::endl;
+    return 1;
+  }
+
+  if (column1.physical_type() != column2.physical_type()) {
+    out
+      << "Column " << columnNumber << " (" << column1.name() << ") physical type:" << std::endl
+      << "-" << TypeToString(column1.physical_type()) << std::endl
+      << "+" << TypeToString(column2.physical_type()) << std::endl;
+    return 1;
+  }
+
+  if (!column1.logical_type()->Equals(*(column2.logical_type()))) {
+    out
+      << "Column " << columnNumber << " (" << column1.name() << ") logical type:" << std::endl
+      << "-" << column1.logical_type()->ToString() << std::endl
+      << "+" << column2.logical_type()->ToString() << std::endl;
+    return 1;
+  }
+
+  // Leaves of different nested columns may share a name and types
+  if (column1.path()->ToDotString() != column2.path()->ToDotString()) {
+    out
+      << "Column " << columnNumber << " path:" << std::endl
+      << "-" << column1.path()->ToDotString() << std::endl
+      << "+" << column2.path()->ToDotString() << std::endl;
+    return 1;
+  }
+
+  if (column1.max_definition_level() != column2.max_definition_level() || column1.max_repetition_level() != column2.max_repetition_level()) {
+    out
+      << "Column " << columnNumber << " (" << column1.name() << ") nesting:" << std::endl
+      << "-max_definition_level " << column1.max_definition_level() << ", max_repetition_level " << column1.max_repetition_level() << std::endl
+      << "+max_definition_level " << column2.max_definition_level() << ", max_repetition_level " << column2.max_repetition_level() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int diffSchema(const parquet::SchemaDescriptor& schema1, const parquet::SchemaDescriptor& schema2, std::ostream& out) {
+  const int nColumns = schema1.num_columns();
+  if (schema2.num_columns() != nColumns) {
+    out << "Number of columns:" << std::endl << "-" << nColumns << std::endl << "+" << schema2.num_columns() << std::endl;
+    return 1;
+  }
+
+  for (int i = 0; i < nColumns; i++) {
+    if (diffColumn(i, *(schema1.Column(i)), *(schema2.Column(i)), out)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+/**
+ * Return 0 if an Arrow file's schema is what Arrow's Parquet reader makes of
+ * a Parquet file's (as parquet-to-arrow reads it), or write the first
+ * difference and return 1.
+ *
+ * A dictionary type matches its value type: Parquet doesn't say whether
+ * a column was dictionary-encoded in Arrow.
+ */
+int diffArrowSchema(const parquet::FileMetaData& metadata1, const arrow::Schema& schema2, std::ostream& out) {
+  const parquet::SchemaDescriptor& schema1 = *metadata1.schema();
+  const int nColumns = schema1.num_columns();
+  for (int i = 0; i < nColumns; i++) {
+    if (isNested(*schema1.Column(i))) {
+      throw std::runtime_error("Column " + std::to_string(i) + " (" + schema1.Column(i)->name() + ") is nested, and --arrow doesn't support that");
+    }
+  }
+
+  if (schema2.num_fields() != nColumns) {
+    out << "Number of columns:" << std::endl << "-" << nColumns << std::endl << "+" << schema2.num_fields() << std::endl;
+    return 1;
+  }
+
+  std::shared_ptr<arrow::Schema> schema1Arrow;
+  THROW_UNLESS_ARROW_OK(
+    parquet::arrow::FromParquetSchema(&schema1, parquet::ArrowReaderProperties(false), metadata1.key_value_metadata(), &schema1Arrow),
+    "converting Parquet schema to Arrow"
+  );
+
+  auto valueType = [](const std::shared_ptr<arrow::DataType>& type) {
+    return type->id() == arrow::Type::DICTIONARY ? static_cast<const arrow::DictionaryType&>(*type).value_type() : type;
+  };
+  for (int i = 0; i < nColumns; i++) {
+    const arrow::Field& field1 = *schema1Arrow->field(i);
+    const arrow::Field& field2 = *schema2.field(i);
+    if (field1.name() != field2.name()) {
+      out
+        << "Column " << i << " name:" << std::endl
+        << "-" << field1.name() << std::endl
+        << "+" << field2.name() << std::endl;
+      return 1;
+    }
+
+    if (!valueType(field1.type())->Equals(*valueType(field2.type()))) {
+      out
+        << "Column " << i << " (" << field1.name() << ") Arrow type:" << std::endl
+        << "-" << field1.type()->ToString() << std::endl
+        << "+" << field2.type()->ToString() << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+template <typename CType>
+static std::string valueToString(const CType& v);
+
+
+template<>
+std::string valueToString(const int32_t& i32) {
+  return std::to_string(i32);
+}
+
+
+template<>
+std::string valueToString(const int64_t& i64) {
+  return std::to_string(i64);
+}
+
+
+template<>
+std::string valueToString(const parquet::ByteArray& byteArray) {
+	return parquet::ByteArrayToString(byteArray);
+}
+
+
+template<>
+std::string valueToString(const float& value) {
+  static const int kBufferSize = 128; // the number in https://github.com/google/double-conversion/blob/master/test/cctest/test-conversions.cc
+  char buf[kBufferSize];
+  std::fill(&buf[0], &buf[kBufferSize], 0); // initialize
+  double_conversion::StringBuilder builder(buf, kBufferSize);
+  const double_conversion::DoubleToStringConverter& converter(double_conversion::DoubleToStringConverter::EcmaScriptConverter());
+  if (converter.ToShortestSingle(value, &builder)) {
+    // No need to call this->doubleBuilder.Finalize() because we know
+    // where the string ends.
+    return std::string(&buf[0], builder.position());
+  } else {
+    return "(error converting float)";
+    // I guess we can recover from this. According to the docs, there's no
+    // way for this to ever happen anyway.
+  }
+}
+
+
+template<>
+std::string valueToString(const double& value) {
+  static const int kBufferSize = 128; // the number in https://github.com/google/double-conversion/blob/master/test/cctest/test-conversions.cc
+  char buf[kBufferSize];
+  std::fill(&buf[0], &buf[kBufferSize], 0); // initialize
+  double_conversion::StringBuilder builder(&buf[0], kBufferSize);
+  const double_conversion::DoubleToStringConverter& converter(double_conversion::DoubleToStringConverter::EcmaScriptConverter());
+  if (converter.ToShortest(value, &builder)) {
+    // No need to call this->doubleBuilder.Finalize() because we know
+    // where the string ends.
+    return std::string(&buf[0], builder.position());
+  } else {
+    return "(error converting double)";
+    // I guess we can recover from this. According to the docs, there's no
+    // way for this to ever happen anyway.
+  }
+}
+
+
+/**
+ * Return the index of the first byte where `a` and `b` differ, or `size`.
+ *
+ * memcmp() checks a block at a time: glibc picks the widest vector
+ * instructions the CPU has (32 or 64 bytes per step on AVX2/AVX-512). Only
+ * in a block that differs do we look for the byte, eight at a time.
+ */
+static size_t
+firstDifferentByte(const uint8_t* a, const uint8_t* b, size_t size)
+{
+  static const size_t kBlockSize = 1024;
+  for (size_t start = 0; start < size; start += kBlockSize) {
+    const size_t end = std::min(start + kBlockSize, size);
+    if (std::memcmp(a + start, b + start, end - start) == 0) {
+      continue;
+    }
+
+    size_t i = start;
+    for (; i + 8 <= end; i += 8) {
+      uint64_t wordA;
+      uint64_t wordB;
+      std::memcpy(&wordA, a + i, 8);
+      std::memcpy(&wordB, b + i, 8);
+      if (wordA != wordB) {
+        return i + (__builtin_ctzll(wordA ^ wordB) >> 3); // little-endian
+      }
+    }
+    for (; i < end; i++) {
+      if (a[i] != b[i]) return i;
+    }
+  }
+  return size;
+}
+
+
+/**
+ * Return the index of the first value where `a` and `b` differ, or `n`.
+ *
+ * Values are equal if their bytes are, or (floats) if they compare equal:
+ * -0.0 equals 0.0, and NaN equals NaN with the same bits.
+ */
+template <typename T>
+static size_t
+firstDifferentValue(const T* a, const T* b, size_t n)
+{
+  size_t start = 0;
+  while (start < n) {
+    const size_t i = start + firstDifferentByte(
+      reinterpret_cast<const uint8_t*>(a + start),
+      reinterpret_cast<const uint8_t*>(b + start),
+      (n - start) * sizeof(T)
+    ) / sizeof(T);
+    if constexpr (std::is_floating_point<T>::value) {
+      if (i < n && a[i] == b[i]) {
+        start = i + 1;
+        continue;
+      }
+    }
+    return i;
+  }
+  return n;
+}
+
+
+/**
+ * Read exactly `nRows` levels (and their values) into `valid` and `values`.
+ *
+ * Throw if the chunk ends first.
+ *
+ * Only for fixed-width values: a ByteArray points into a page, which the
+ * next ReadBatch() may overwrite.
+ */
+template <typename DType, typename Chunk>
+void
+readRows(Chunk& chunk, int64_t nRows, int16_t* valid, typename DType::c_type* values)
+{
+  int64_t nRead = 0;
+  int64_t nValues = 0;
+  while (nRead < nRows) {
+    int64_t nValuesThisBatch;
+    const int64_t n = chunk.ReadBatch(nRows - nRead, &valid[nRead], nullptr, &values[nValues], &nValuesThisBatch);
+    if (n == 0) {
+      throw std::runtime_error("Parquet column chunk has fewer values than its row group");
+    }
+    if (nValuesThisBatch == n) {
+      // No nulls. (A required column has no definition levels, so
+      // ReadBatch() didn't write them.)
+      std::fill(&valid[nRead], &valid[nRead + n], 1);
+    }
+    nRead += n;
+    nValues += nValuesThisBatch;
+  }
+}
+
+
+/**
+ * Collects the differences in one column chunk: the first `maxExamples` as
+ * text, and a count of all of them.
+ */
+class ChunkDifferences {
+  std::string location; // "RowGroup 1, Column 2" or (whole-file) "Column 2"
+  int64_t maxExamples;
+  bool countAll; // false: stop once we have maxExamples
+  int64_t n;
+  std::vector<std::string> examples;
+
+public:
+  ChunkDifferences(const std::string& location_, int64_t maxExamples_, bool countAll_)
+    : location(location_)
+    , maxExamples(maxExamples_)
+    , countAll(countAll_)
+    , n(0)
+  {
+  }
+
+  template <typename CType>
+  void add(int64_t row, const CType* value1, const CType* value2) {
+    if (this->n < this->maxExamples) {
+      std::ostringstream out;
+      out
+        << this->location << ", Row " << row << ":" << std::endl
+        << "-" << (value1 ? valueToString(*value1) : "(null)") << std::endl
+        << "+" << (value2 ? valueToString(*value2) : "(null)") << std::endl;
+      this->examples.push_back(out.str());
+    }
+    this->n++;
+  }
+
+  /**
+   * Record a difference in item `item` of a nested column's row (or, if
+   * `item` is -1, in the row). We call format1() and format2() for the two
+   * sides' text only if we'll write it.
+   */
+  template <typename Format1, typename Format2>
+  void addItem(int64_t row, int64_t item, Format1 format1, Format2 format2) {
+    if (this->n < this->maxExamples) {
+      std::ostringstream out;
+      out << this->location << ", Row " << row;
+      if (item >= 0) {
+        out << ", Item " << item;
+      }
+      out << ":" << std::endl << "-" << format1() << std::endl << "+" << format2() << std::endl;
+      this->examples.push_back(out.str());
+    }
+    this->n++;
+  }
+
+  /**
+   * Record a difference that isn't about one cell.
+   */
+  void addNote(const std::string& text) {
+    if (this->n < this->maxExamples) {
+      this->examples.push_back(text);
+    }
+    this->n++;
+  }
+
+  /** Return true if the caller may stop comparing. */
+  bool done() const { return !this->countAll && this->n >= this->maxExamples; }
+
+  const std::string& getLocation() const { return this->location; }
+  int64_t nDifferences() const { return this->n; }
+  const std::vector<std::string>& getExamples() const { return this->examples; }
+};
+
+
+/**
+ * Compare rows `firstRow` to `firstRow + nRows` of two column chunks (or
+ * ColumnStreams, or ArrowColumnStreams), in constant memory, adding
+ * differing cells to `differences` until it's done().
+ *
+ * We Skip() the rows before `firstRow` without comparing them.
+ *
+ * Stop early if `shouldStop()` says nobody needs the answer any more.
+ *
+ * Fixed-width values: we read both chunks in batches of kCompareBatchSize
+ * rows and compare whole arrays (definition levels, then values) with
+ * firstDifferentValue(). Byte arrays: we compare value by value, length
+ * first.
+ */
+template <typename DType, typename Chunk1, typename Chunk2, typename ShouldStop>
+void diffColumnChunkTyped(Chunk1& chunk1, Chunk2& chunk2, int64_t firstRow, int64_t nRows, ChunkDifferences& differences, ShouldStop shouldStop) {
+  typedef typename DType::c_type CType;
+
+  if (firstRow > 0 && (chunk1.Skip(firstRow) != firstRow || chunk2.Skip(firstRow) != firstRow)) {
+    throw std::runtime_error("Parquet column chunk has fewer values than its row group");
+  }
+
+  if constexpr (std::is_same<CType, parquet::ByteArray>::value) {
+    BatchedChunkReader<DType, Chunk1> reader1(chunk1);
+    BatchedChunkReader<DType, Chunk2> reader2(chunk2);
+
+    for (int64_t i = 0; i < nRows; i++) {
+      if (i % kRowsPerStopCheck == 0 && shouldStop()) {
+        return;
+      }
+
+      const CType* value1 = reader1.next(); // nullptr = null
+      const CType* value2 = reader2.next(); // nullptr = null
+      if (
+        value1 && value2
+        ? (value1->len != value2->len || std::memcmp(value1->ptr, value2->ptr, value1->len) != 0)
+        : value1 != value2
+      ) {
+        differences.add(firstRow + i, value1, value2);
+        if (differences.done()) return;
+      }
+    }
+  } else {
+    std::vector<int16_t> valid1(kCompareBatchSize); // 1 = there is a value; 0 = skipped a value
+    std::vector<int16_t> valid2(kCompareBatchSize);
+    std::vector<CType> values1(kCompareBatchSize); // nulls not included
+    std::vector<CType> values2(kCompareBatchSize);
+
+    for (int64_t batchStart = 0; batchStart < nRows; batchStart += kCompareBatchSize) {
+      if (batchStart % kRowsPerStopCheck == 0 && shouldStop()) {
+        return;
+      }
+
+      const int64_t batchSize = std::min(kCompareBatchSize, nRows - batchStart);
+      readRows<DType>(chunk1, batchSize, &valid1[0], &values1[0]);
+      readRows<DType>(chunk2, batchSize, &valid2[0], &values2[0]);
+
+      int64_t row = 0; // next row to compare
+      int64_t value1 = 0; // index in values1 of the first value at or after `row`
+      int64_t value2 = 0; // index in values2 of the first value at or after `row`
+      while (row < batchSize) {
+        // Rows before validMismatch have nulls in the same places, so their
+        // values line up
+        const int64_t validMismatch = row + firstDifferentValue(&valid1[row], &valid2[row], batchSize - row);
+        const int64_t nComparableValues = std::count(&valid1[row], &valid1[validMismatch], 1);
+
+        int64_t valueRow = row; // row of value `value1 + nValuesBefore`
+        int64_t nValuesBefore = 0;
+        for (int64_t i = 0; i < nComparableValues; i++) {
+          i += firstDifferentValue(&values1[value1 + i], &values2[value2 + i], nComparableValues - i);
+          if (i == nComparableValues) break;
+
+          // Find the row of the i'th value
+          for (; nValuesBefore < i || !valid1[valueRow]; valueRow++) {
+            nValuesBefore += valid1[valueRow];
+          }
+          differences.add(firstRow + batchStart + valueRow, &values1[value1 + i], &values2[value2 + i]);
+          if (differences.done()) return;
+        }
+        value1 += nComparableValues;
+        value2 += nComparableValues;
+        row = validMismatch;
+
+        if (row < batchSize) {
+          differences.add(
+            firstRow + batchStart + row,
+            valid1[row] ? &values1[value1] : nullptr,
+            valid2[row] ? &values2[value2] : nullptr
+          );
+          if (differences.done()) return;
+          value1 += valid1[row];
+          value2 += valid2[row];
+          row++;
+        }
+      }
+    }
+  }
+}
+
+
+/**
+ * Return how to write a nested column's item at each definition level below
+ * the maximum: "(null)" if it's a null leaf value, "(null name)" if it's in a
+ * null group (such as a struct or list) named `name`, or "(empty)" if it's
+ * an empty list.
+ */
+static std::vector<std::string>
+describeUndefinedItems(const parquet::ColumnDescriptor& column)
+{
+  std::vector<const parquet::schema::Node*> path; // from the root's child to the leaf
+  for (const parquet::schema::Node* node = column.schema_node().get(); node->parent(); node = node->parent()) {
+    path.insert(path.begin(), node);
+  }
+
+  std::vector<std::string> ret; // one entry per definition level
+  for (const parquet::schema::Node* node : path) {
+    if (node->is_optional()) {
+      ret.push_back(node->is_primitive() ? "(null)" : "(null " + node->name() + ")");
+    } else if (node->is_repeated()) {
+      ret.push_back("(empty)");
+    }
+  }
+  return ret;
+}
+
+
+/**
+ * Return the index of the `n`th (counting from 1) zero in `levels`, or
+ * `size` if there are fewer.
+ */
+static int64_t
+findNthZero(const int16_t* levels, int64_t size, int64_t n)
+{
+  const int16_t* p = levels;
+  for (int64_t i = 0; i < n; i++) {
+    p = std::find(i == 0 ? p : p + 1, levels + size, 0);
+    if (p == levels + size) break;
+  }
+  return p - levels;
+}
+
+
+/**
+ * One side of a nested comparison: a batch of definition levels, repetition
+ * levels and (for fully-defined items) values from a column chunk or
+ * ColumnStream.
+ *
+ * Each level is one item; a repetition level of 0 starts a row.
+ */
+template <typename DType, typename Chunk>
+struct LevelBatch {
+  typedef typename DType::c_type CType;
+
+  Chunk& chunk;
+  const int16_t maxDefinitionLevel;
+  const bool hasRepetitionLevels;
+  std::vector<int16_t> defLevels;
+  std::vector<int16_t> repLevels;
+  std::vector<CType> values; // one per item with maxDefinitionLevel
+  int64_t size;
+  int64_t level; // next item
+  int64_t value; // next index in `values`
+
+  LevelBatch(Chunk& chunk_, const parquet::ColumnDescriptor& column)
+    : chunk(chunk_)
+    , maxDefinitionLevel(column.max_definition_level())
+    , hasRepetitionLevels(column.max_repetition_level() > 0)
+    , defLevels(kCompareBatchSize)
+    , repLevels(kCompareBatchSize)
+    , values(kCompareBatchSize)
+    , size(0)
+    , level(0)
+    , value(0)
+  {
+  }
+
+  /**
+   * Read the next batch if we're done with this one. Return false at the
+   * end of the chunk.
+   *
+   * ByteArray values point into the chunk's page: they're valid until the
+   * next read.
+   */
+  bool refill() {
+    if (this->level < this->size) return true;
+    int64_t nValues;
+    this->size = this->chunk.ReadBatch(kCompareBatchSize, &this->defLevels[0], &this->repLevels[0], &this->values[0], &nValues);
+    if (!this->hasRepetitionLevels) {
+      // ReadBatch() didn't write them: every item starts a row
+      std::fill(&this->repLevels[0], &this->repLevels[this->size], 0);
+    }
+    this->level = 0;
+    this->value = 0;
+    return this->size > 0;
+  }
+
+  /** Return the next item's value, or nullptr if it isn't fully defined. */
+  const CType* itemValue() const {
+    return this->defLevels[this->level] == this->maxDefinitionLevel ? &this->values[this->value] : nullptr;
+  }
+
+  /** Move past `n` items of this batch. */
+  void advance(int64_t n) {
+    this->value += std::count(&this->defLevels[this->level], &this->defLevels[this->level + n], this->maxDefinitionLevel);
+    this->level += n;
+  }
+
+  /** Move past items until the next one starts a row. */
+  void skipRestOfRow() {
+    while (this->refill() && this->repLevels[this->level] != 0) {
+      const int64_t rowEnd = std::find(&this->repLevels[this->level], &this->repLevels[this->size], 0) - &this->repLevels[0];
+      this->advance(rowEnd - this->level);
+    }
+  }
+
+  /** Move past `nRows` rows. Call at the start of a row. */
+  void skipRows(int64_t nRows) {
+    for (int64_t i = 0; i < nRows && this->refill(); i++) {
+      this->advance(1);
+      this->skipRestOfRow();
+    }
+  }
+};
+
+
+/**
+ * Compare rows `firstRow` to `firstRow + nRows` of two chunks (or
+ * ColumnStreams) of a nested column -- a leaf with repetition levels or
+ * more than one definition level -- in constant memory.
+ *
+ * We compare three parallel streams, a batch at a time, with
+ * firstDifferentValue(): definition levels, repetition levels and values.
+ * A row is one or more items (repetition level 0 starts a row), and a
+ * difference is a row: we report its first differing item (or "(end of
+ * row)" if one side's row is shorter), then skip to the next row on both
+ * sides.
+ */
+template <typename DType, typename Chunk1, typename Chunk2, typename ShouldStop>
+void diffNestedColumnChunkTyped(const parquet::ColumnDescriptor& column, Chunk1& chunk1, Chunk2& chunk2, int64_t firstRow, int64_t nRows, ChunkDifferences& differences, ShouldStop shouldStop) {
+  typedef typename DType::c_type CType;
+
+  const int16_t maxDefinitionLevel = column.max_definition_level();
+  const bool isRepeated = column.max_repetition_level() > 0;
+  const std::vector<std::string> undefinedItems(describeUndefinedItems(column));
+  LevelBatch<DType, Chunk1> batch1(chunk1, column);
+  LevelBatch<DType, Chunk2> batch2(chunk2, column);
+  batch1.skipRows(firstRow);
+  batch2.skipRows(firstRow);
+
+  int64_t row = -1; // row of the last item we passed (counting from firstRow)
+  int64_t item = 0; // the next item's index in `row`, if it doesn't start a row
+  int64_t nextStopCheck = 0;
+  while (true) {
+    if (row >= nextStopCheck) {
+      if (shouldStop()) return;
+      nextStopCheck = row + kRowsPerStopCheck;
+    }
+
+    // Does each side have an item in rows before nRows?
+    const bool hasItem1 = batch1.refill() && (batch1.repLevels[batch1.level] != 0 || row + 1 < nRows);
+    const bool hasItem2 = batch2.refill() && (batch2.repLevels[batch2.level] != 0 || row + 1 < nRows);
+    if (!hasItem1 && !hasItem2) return;
+
+    if (hasItem1 && hasItem2) {
+      // Compare the items both batches have, up to row nRows
+      const int16_t* def1 = &batch1.defLevels[batch1.level];
+      const int16_t* def2 = &batch2.defLevels[batch2.level];
+      const int16_t* rep1 = &batch1.repLevels[batch1.level];
+      const int16_t* rep2 = &batch2.repLevels[batch2.level];
+      int64_t n = std::min(batch1.size - batch1.level, batch2.size - batch2.level);
+      n = findNthZero(rep1, n, nRows - row); // row `nRows` starts at the (nRows - row)th row start
+
+      int64_t nEqual = firstDifferentValue(rep1, rep2, n);
+      nEqual = firstDifferentValue(def1, def2, nEqual);
+      const int64_t nValues = std::count(def1, def1 + nEqual, maxDefinitionLevel);
+      int64_t nEqualValues = 0;
+      if constexpr (std::is_same<CType, parquet::ByteArray>::value) {
+        while (nEqualValues < nValues && batch1.values[batch1.value + nEqualValues] == batch2.values[batch2.value + nEqualValues]) {
+          nEqualValues++;
+        }
+      } else {
+        nEqualValues = firstDifferentValue(&batch1.values[batch1.value], &batch2.values[batch2.value], nValues);
+      }
+      if (nEqualValues < nValues) {
+        // Stop at the item with the first differing value
+        int64_t nValuesBefore = 0;
+        for (int64_t i = 0; i < nEqual; i++) {
+          if (def1[i] == maxDefinitionLevel && nValuesBefore++ == nEqualValues) {
+            nEqual = i;
+            break;
+          }
+        }
+      }
+
+      const int64_t nRowStarts = std::count(rep1, rep1 + nEqual, 0);
+      if (nRowStarts > 0) {
+        int64_t lastRowStart = nEqual - 1;
+        while (rep1[lastRowStart] != 0) lastRowStart--;
+        row += nRowStarts;
+        item = nEqual - lastRowStart;
+      } else {
+        item += nEqual;
+      }
+      batch1.advance(nEqual);
+      batch2.advance(nEqual);
+      if (nEqual == n) continue;
+    }
+
+    // The next items differ
+    for (const bool ended : { !batch1.refill(), !batch2.refill() }) {
+      if (ended && row + 1 < nRows) {
+        throw std::runtime_error("Parquet column chunk has fewer rows than its row group");
+      }
+    }
+    const bool startsRow1 = !hasItem1 || batch1.repLevels[batch1.level] == 0;
+    const bool startsRow2 = !hasItem2 || batch2.repLevels[batch2.level] == 0;
+    const bool bothStartRow = hasItem1 && hasItem2 && startsRow1 && startsRow2;
+    if (bothStartRow) {
+      row++;
+      item = 0;
+    }
+    auto formatItem = [&](const auto& batch, bool endedRow, const auto& otherBatch, bool otherEndedRow) {
+      if (endedRow && !bothStartRow) {
+        return std::string("(end of row)");
+      }
+      const CType* value = batch.itemValue();
+      std::string text = value ? valueToString(*value) : undefinedItems[batch.defLevels[batch.level]];
+      if (!otherEndedRow && otherBatch.repLevels[otherBatch.level] != batch.repLevels[batch.level]) {
+        text += " (repetition level " + std::to_string(batch.repLevels[batch.level]) + ")";
+      }
+      return text;
+    };
+    differences.addItem(
+      firstRow + row,
+      isRepeated ? item : -1,
+      [&]() { return formatItem(batch1, startsRow1, batch2, startsRow2 && !bothStartRow); },
+      [&]() { return formatItem(batch2, startsRow2, batch1, startsRow1 && !bothStartRow); }
+    );
+    if (differences.done()) return;
+
+    // Move both sides to the start of the next row
+    if (bothStartRow) {
+      batch1.advance(1);
+      batch2.advance(1);
+    }
+    batch1.skipRestOfRow();
+    batch2.skipRestOfRow();
+  }
+}
+
+
+template <typename ShouldStop>
+void diffColumnChunk(parquet::ColumnReader* chunk1, parquet::ColumnReader* chunk2, int64_t firstRow, int64_t nRows, ChunkDifferences& differences, ShouldStop shouldStop) {
+  const parquet::ColumnDescriptor& column = *chunk1->descr();
+#define HANDLE_TYPED(type) \
+  { \
+    auto chunk1Typed(dynamic_cast<parquet::TypedColumnReader<type>*>(chunk1)); \
+    auto chunk2Typed(dynamic_cast<parquet::TypedColumnReader<type>*>(chunk2)); \
+    if (chunk1Typed && chunk2Typed) { \
+      if (isNested(column)) { \
+        diffNestedColumnChunkTyped<type>(column, *chunk1Typed, *chunk2Typed, firstRow, nRows, differences, shouldStop); \
+      } else { \
+        diffColumnChunkTyped<type>(*chunk1Typed, *chunk2Typed, firstRow, nRows, differences, shouldStop); \
+      } \
+      return; \
+    } \
+  }
+  HANDLE_TYPED(parquet::Int32Type)
+  HANDLE_TYPED(parquet::Int64Type)
+  HANDLE_TYPED(parquet::FloatType)
+  HANDLE_TYPED(parquet::DoubleType)
+  HANDLE_TYPED(parquet::ByteArrayType)
+#undef HANDLE_TYPED
+  differences.addNote(differences.getLocation() + ": unhandled physical data type");
+}
+
+
+/**
+ * Compare rows `firstRow` to `firstRow + nRows` of one column in two files,
+ * reading each column as one stream across row-group boundaries (for
+ * --loose-row-groups).
+ */
+template <typename ShouldStop>
+void diffColumnStreams(parquet::ParquetFileReader& file1, parquet::ParquetFileReader& file2, int columnNumber, int64_t firstRow, int64_t nRows, ChunkDifferences& differences, ShouldStop shouldStop) {
+  const parquet::ColumnDescriptor& column = *file1.metadata()->schema()->Column(columnNumber);
+  switch (column.physical_type()) {
+#define HANDLE_TYPED(physicalType, type) \
+    case physicalType: \
+      { \
+        ColumnStream<type> stream1(file1, columnNumber); \
+        ColumnStream<type> stream2(file2, columnNumber); \
+        if (isNested(column)) { \
+          diffNestedColumnChunkTyped<type>(column, stream1, stream2, firstRow, nRows, differences, shouldStop); \
+        } else { \
+          diffColumnChunkTyped<type>(stream1, stream2, firstRow, nRows, differences, shouldStop); \
+        } \
+        return; \
+      }
+    HANDLE_TYPED(parquet::Type::INT32, parquet::Int32Type)
+    HANDLE_TYPED(parquet::Type::INT64, parquet::Int64Type)
+    HANDLE_TYPED(parquet::Type::FLOAT, parquet::FloatType)
+    HANDLE_TYPED(parquet::Type::DOUBLE, parquet::DoubleType)
+    HANDLE_TYPED(parquet::Type::BYTE_ARRAY, parquet::ByteArrayType)
+#undef HANDLE_TYPED
+    default:
+      differences.addNote(differences.getLocation() + ": unhandled physical data type");
+  }
+}
+
+
+/**
+ * An Arrow IPC file (such as parquet-to-arrow writes), memory-mapped.
+ *
+ * Arrow's reader slices record batches' buffers out of the mapping: holding
+ * every column copies nothing, and the kernel pages data in as we read it.
+ */
+struct ArrowFile {
+  std::shared_ptr<arrow::io::MemoryMappedFile> file;
+  std::shared_ptr<arrow::Schema> schema;
+  std::vector<std::vector<std::shared_ptr<arrow::Array>>> columns; // [column][recordBatch]
+  int64_t nRows;
+
+  explicit ArrowFile(const std::string& path)
+    : nRows(0)
+  {
+    this->file = THROW_UNLESS_ARROW_OK(arrow::io::MemoryMappedFile::Open(path, arrow::io::FileMode::READ), "opening Arrow file");
+    std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader(THROW_UNLESS_ARROW_OK(
+      arrow::ipc::RecordBatchFileReader::Open(this->file),
+      "reading Arrow file"
+    ));
+    this->schema = reader->schema();
+    this->columns.resize(this->schema->num_fields());
+    for (int i = 0; i < reader->num_record_batches(); i++) {
+      std::shared_ptr<arrow::RecordBatch> recordBatch(THROW_UNLESS_ARROW_OK(reader->ReadRecordBatch(i), "reading Arrow record batch"));
+      for (int j = 0; j < recordBatch->num_columns(); j++) {
+        this->columns[j].push_back(recordBatch->column(j));
+      }
+      this->nRows += recordBatch->num_rows();
+    }
+  }
+};
+
+
+static std::runtime_error
+unexpectedArrowType(const arrow::Array& array, const char* physicalType)
+{
+  return std::runtime_error("Arrow type " + array.type()->ToString() + " does not match Parquet physical type " + physicalType);
+}
+
+
+/**
+ * Copy `n` cells of an Arrow array, starting at `offset`, into `valid` and
+ * `values` (nulls not included), converting each value to the Parquet
+ * physical type Arrow's Parquet reader converted it from.
+ *
+ * Return the number of values.
+ */
+template <typename ArrowCType, typename CType>
+static int64_t
+copyArrowValues(const arrow::Array& array, int64_t offset, int64_t n, int16_t* valid, CType* values)
+{
+  const ArrowCType* arrowValues = array.data()->GetValues<ArrowCType>(1);
+  int64_t nValues = 0;
+  for (int64_t i = 0; i < n; i++) {
+    valid[i] = array.IsValid(offset + i);
+    if (valid[i]) {
+      values[nValues++] = static_cast<CType>(arrowValues[offset + i]);
+    }
+  }
+  return nValues;
+}
+
+
+template <typename BinaryArrayType>
+static int64_t
+copyArrowByteArrays(const arrow::Array& array, int64_t offset, int64_t n, int16_t* valid, parquet::ByteArray* values)
+{
+  const BinaryArrayType& binaryArray(static_cast<const BinaryArrayType&>(array));
+  int64_t nValues = 0;
+  for (int64_t i = 0; i < n; i++) {
+    valid[i] = binaryArray.IsValid(offset + i);
+    if (valid[i]) {
+      const auto value = binaryArray.GetView(offset + i); // arrow::util::string_view, in Arrow 4
+      values[nValues++] = parquet::ByteArray(value.size(), reinterpret_cast<const uint8_t*>(value.data()));
+    }
+  }
+  return nValues;
+}
+
+
+static int64_t
+copyArrowDictionaryByteArrays(const arrow::Array& array, int64_t offset, int64_t n, int16_t* valid, parquet::ByteArray* values)
+{
+  const arrow::DictionaryArray& dictionaryArray(static_cast<const arrow::DictionaryArray&>(array));
+  const arrow::Array& dictionary(*dictionaryArray.dictionary());
+  if (dictionary.type_id() != arrow::Type::STRING && dictionary.type_id() != arrow::Type::BINARY) {
+    throw unexpectedArrowType(array, "BYTE_ARRAY");
+  }
+  const arrow::BinaryArray& binaryDictionary(static_cast<const arrow::BinaryArray&>(dictionary));
+  int64_t nValues = 0;
+  for (int64_t i = 0; i < n; i++) {
+    valid[i] = dictionaryArray.IsValid(offset + i);
+    if (valid[i]) {
+      const auto value = binaryDictionary.GetView(dictionaryArray.GetValueIndex(offset + i));
+      values[nValues++] = parquet::ByteArray(value.size(), reinterpret_cast<const uint8_t*>(value.data()));
+    }
+  }
+  return nValues;
+}
+
+
+static int64_t
+copyArrowBatch(const arrow::Array& array, int64_t offset, int64_t n, int16_t* valid, int32_t* values)
+{
+  switch (array.type_id()) {
+    case arrow::Type::INT8: return copyArrowValues<int8_t>(array, offset, n, valid, values);
+    case arrow::Type::INT16: return copyArrowValues<int16_t>(array, offset, n, valid, values);
+    case arrow::Type::INT32:
+    case arrow::Type::DATE32:
+    case arrow::Type::TIME32:
+      return copyArrowValues<int32_t>(array, offset, n, valid, values);
+    case arrow::Type::UINT8: return copyArrowValues<uint8_t>(array, offset, n, valid, values);
+    case arrow::Type::UINT16: return copyArrowValues<uint16_t>(array, offset, n, valid, values);
+    case arrow::Type::UINT32: return copyArrowValues<uint32_t>(array, offset, n, valid, values);
+    default: throw unexpectedArrowType(array, "INT32");
+  }
+}
+
+
+static int64_t
+copyArrowBatch(const arrow::Array& array, int64_t offset, int64_t n, int16_t* valid, int64_t* values)
+{
+  switch (array.type_id()) {
+    case arrow::Type::INT64:
+    case arrow::Type::TIMESTAMP:
+    case arrow::Type::TIME64:
+    case arrow::Type::DURATION:
+      return copyArrowValues<int64_t>(array, offset, n, valid, values);
+    case arrow::Type::UINT64: return copyArrowValues<uint64_t>(array, offset, n, valid, values);
+    default: throw unexpectedArrowType(array, "INT64");
+  }
+}
+
+
+static int64_t
+copyArrowBatch(const arrow::Array& array, int64_t offset, int64_t n, int16_t* valid, float* values)
+{
+  if (array.type_id() != arrow::Type::FLOAT) throw unexpectedArrowType(array, "FLOAT");
+  return copyArrowValues<float>(array, offset, n, valid, values);
+}
+
+
+static int64_t
+copyArrowBatch(const arrow::Array& array, int64_t offset, int64_t n, int16_t* valid, double* values)
+{
+  if (array.type_id() != arrow::Type::DOUBLE) throw unexpectedArrowType(array, "DOUBLE");
+  return copyArrowValues<double>(array, offset, n, valid, values);
+}
+
+
+static int64_t
+copyArrowBatch(const arrow::Array& array, int64_t offset, int64_t n, int16_t* valid, parquet::ByteArray* values)
+{
+  switch (array.type_id()) {
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+      return copyArrowByteArrays<arrow::BinaryArray>(array, offset, n, valid, values);
+    case arrow::Type::LARGE_STRING:
+    case arrow::Type::LARGE_BINARY:
+      return copyArrowByteArrays<arrow::LargeBinaryArray>(array, offset, n, valid, values);
+    case arrow::Type::DICTIONARY: return copyArrowDictionaryByteArrays(array, offset, n, valid, values);
+    default: throw unexpectedArrowType(array, "BYTE_ARRAY");
+  }
+}
+
+
+/**
+ * Reads one column of an ArrowFile, record batch after record batch, as
+ * though it were a Parquet column chunk (for --arrow).
+ *
+ * ReadBatch() works like ColumnStream::ReadBatch(), converting Arrow values
+ * back to Parquet physical values, so diffColumnChunkTyped() can compare a
+ * ColumnStream with an ArrowColumnStream. ByteArray values point into the
+ * Arrow file (or, for dictionary arrays, its dictionary), never copied.
+ */
+template <typename DType>
+class ArrowColumnStream {
+  const std::vector<std::shared_ptr<arrow::Array>>& arrays;
+  size_t arrayIndex;
+  int64_t offset; // next row in arrays[arrayIndex]
+
+public:
+  ArrowColumnStream(const ArrowFile& file, int columnNumber)
+    : arrays(file.columns[columnNumber])
+    , arrayIndex(0)
+    , offset(0)
+  {
+  }
+
+  int64_t ReadBatch(int64_t batchSize, int16_t* defLevels, int16_t* repLevels, typename DType::c_type* values, int64_t* valuesRead) {
+    while (this->arrayIndex < this->arrays.size() && this->offset == this->arrays[this->arrayIndex]->length()) {
+      this->arrayIndex++;
+      this->offset = 0;
+    }
+    if (this->arrayIndex == this->arrays.size()) {
+      *valuesRead = 0;
+      return 0;
+    }
+
+    const arrow::Array& array(*this->arrays[this->arrayIndex]);
+    const int64_t n = std::min(batchSize, array.length() - this->offset);
+    *valuesRead = copyArrowBatch(array, this->offset, n, defLevels, values);
+    this->offset += n;
+    return n;
+  }
+
+  /**
+   * Skip the next `nRows` rows. Return the number of rows skipped.
+   */
+  int64_t Skip(int64_t nRows) {
+    int64_t nSkipped = 0;
+    while (nSkipped < nRows && this->arrayIndex < this->arrays.size()) {
+      const int64_t n = std::min(nRows - nSkipped, this->arrays[this->arrayIndex]->length() - this->offset);
+      nSkipped += n;
+      this->offset += n;
+      if (this->offset == this->arrays[this->arrayIndex]->length()) {
+        this->arrayIndex++;
+        this->offset = 0;
+      }
+    }
+    return nSkipped;
+  }
+};
+
+
+/**
+ * Compare rows `firstRow` to `firstRow + nRows` of one column in a Parquet
+ * file and an Arrow file (for --arrow).
+ */
+template <typename ShouldStop>
+void diffArrowColumn(parquet::ParquetFileReader& file1, const ArrowFile& file2, int columnNumber, int64_t firstRow, int64_t nRows, ChunkDifferences& differences, ShouldStop shouldStop) {
+  switch (file1.metadata()->schema()->Column(columnNumber)->physical_type()) {
+#define HANDLE_TYPED(physicalType, type) \
+    case physicalType: \
+      { \
+        ColumnStream<type> stream1(file1, columnNumber); \
+        ArrowColumnStream<type> stream2(file2, columnNumber); \
+        diffColumnChunkTyped<type>(stream1, stream2, firstRow, nRows, differences, shouldStop); \
+        return; \
+      }
+    HANDLE_TYPED(parquet::Type::INT32, parquet::Int32Type)
+    HANDLE_TYPED(parquet::Type::INT64, parquet::Int64Type)
+    HANDLE_TYPED(parquet::Type::FLOAT, parquet::FloatType)
+    HANDLE_TYPED(parquet::Type::DOUBLE, parquet::DoubleType)
+    HANDLE_TYPED(parquet::Type::BYTE_ARRAY, parquet::ByteArrayType)
+#undef HANDLE_TYPED
+    default:
+      differences.addNote(differences.getLocation() + ": unhandled physical data type");
+  }
+}
+
+
+typedef PageColumnReader<parquet::ByteArrayReader, std::string_view> StringPageReader;
+
+
+/**
+ * One side of a dictionary-aware comparison: a batch of rows from one page,
+ * as dictionary indices if the page is dictionary-encoded.
+ */
+struct StringChunkBatch {
+  StringPageReader reader;
+  std::vector<int16_t> valid; // 1 = there is a value; 0 = skipped a value
+  std::vector<uint32_t> indices; // nulls not included; if isDictionary
+  std::vector<parquet::ByteArray> values; // nulls not included; if !isDictionary
+  bool isDictionary;
+  int64_t size;
+  int64_t row; // next row in the batch
+  int64_t value; // next index in `indices` or `values`
+
+  StringChunkBatch(const parquet::ColumnDescriptor* column, std::unique_ptr<parquet::PageReader> pageReader, DictionaryBudget& dictionaryBudget)
+    : reader(column, std::move(pageReader), dictionaryBudget)
+    , valid(kCompareBatchSize)
+    , indices(kCompareBatchSize)
+    , values(kCompareBatchSize)
+    , isDictionary(false)
+    , size(0)
+    , row(0)
+    , value(0)
+  {
+  }
+
+  /**
+   * Read the next batch if we're done with this one.
+   */
+  void refill() {
+    if (this->row < this->size) return;
+    this->size = this->reader.readBatch(kCompareBatchSize, &this->valid[0], &this->indices[0], &this->values[0], &this->isDictionary);
+    this->row = 0;
+    this->value = 0;
+  }
+
+  parquet::ByteArray valueAt(int64_t index) const {
+    return this->isDictionary ? this->reader.getDictionaryValue(this->indices[index]) : this->values[index];
+  }
+};
+
+
+/**
+ * Translates two dictionaries' indices to ids that are equal iff their
+ * values are.
+ *
+ * We build it once per pair of dictionaries. When both dictionaries hold
+ * the same values in the same order (the usual case), indices are ids.
+ */
+class DictionaryMapping {
+  static const uint32_t kMissing = UINT32_MAX; // a value dictionary 2 lacks
+
+  uint64_t generation1;
+  uint64_t generation2;
+  bool identity;
+  std::vector<uint32_t> ids1; // if !identity
+  std::vector<uint32_t> ids2; // if !identity
+  std::vector<uint32_t> scratch1; // translate() output
+  std::vector<uint32_t> scratch2;
+
+public:
+  DictionaryMapping() : generation1(0), generation2(0), identity(false), scratch1(kCompareBatchSize), scratch2(kCompareBatchSize) {}
+
+  void update(const StringPageReader& reader1, const StringPageReader& reader2) {
+    if (reader1.getDictionaryGeneration() == this->generation1 && reader2.getDictionaryGeneration() == this->generation2) {
+      return;
+    }
+    this->generation1 = reader1.getDictionaryGeneration();
+    this->generation2 = reader2.getDictionaryGeneration();
+
+    const uint32_t size1 = reader1.getDictionarySize();
+    const uint32_t size2 = reader2.getDictionarySize();
+    this->identity = size1 == size2;
+    for (uint32_t i = 0; i < size1 && this->identity; i++) {
+      this->identity = reader1.getDictionaryValue(i) == reader2.getDictionaryValue(i);
+    }
+    if (this->identity) {
+      return;
+    }
+
+    // Dictionaries should hold distinct values, but needn't: id = the
+    // first index in dictionary 2 with the same value
+    std::unordered_map<std::string_view, uint32_t> idsByValue;
+    idsByValue.reserve(size2);
+    this->ids2.resize(size2);
+    for (uint32_t i = 0; i < size2; i++) {
+      const parquet::ByteArray value = reader2.getDictionaryValue(i);
+      this->ids2[i] = idsByValue.emplace(std::string_view(reinterpret_cast<const char*>(value.ptr), value.len), i).first->second;
+    }
+    this->ids1.resize(size1);
+    for (uint32_t i = 0; i < size1; i++) {
+      const parquet::ByteArray value = reader1.getDictionaryValue(i);
+      auto it = idsByValue.find(std::string_view(reinterpret_cast<const char*>(value.ptr), value.len));
+      this->ids1[i] = it == idsByValue.end() ? kMissing : it->second;
+    }
+  }
+
+  /**
+   * Set `*out1` and `*out2` to `n` comparable ids for the given indices.
+   */
+  void translate(const uint32_t* indices1, const uint32_t* indices2, int64_t n, const uint32_t** out1, const uint32_t** out2) {
+    if (this->identity) {
+      *out1 = indices1;
+      *out2 = indices2;
+      return;
+    }
+    for (int64_t i = 0; i < n; i++) {
+      this->scratch1[i] = this->ids1[indices1[i]];
+      this->scratch2[i] = this->ids2[indices2[i]];
+    }
+    *out1 = &this->scratch1[0];
+    *out2 = &this->scratch2[0];
+  }
+};
+
+
+/**
+ * Compare rows `firstRow` to `firstRow + nRows` of two string column chunks,
+ * reading dictionary indices instead of values where both pages are
+ * dictionary-encoded. We skip pages before `firstRow` without decoding them.
+ *
+ * Dictionary-encoded rows compare as integers: we compare each pair of
+ * dictionaries once, then compare index arrays, a batch at a time. Rows in
+ * PLAIN pages (e.g., after a writer's dictionary grew too big) compare as
+ * bytes.
+ *
+ * Only for flat, nullable columns whose chunks pass
+ * StringPageReader::canDecode().
+ */
+template <typename ShouldStop>
+void diffDictionaryChunks(const parquet::ColumnDescriptor* column, std::unique_ptr<parquet::PageReader> pageReader1, std::unique_ptr<parquet::PageReader> pageReader2, int64_t firstRow, int64_t nRows, ChunkDifferences& differences, ShouldStop shouldStop) {
+  DictionaryBudget dictionaryBudget(-1); // one dictionary per side: the page's size
+  StringChunkBatch batch1(column, std::move(pageReader1), dictionaryBudget);
+  StringChunkBatch batch2(column, std::move(pageReader2), dictionaryBudget);
+  DictionaryMapping mapping;
+  batch1.reader.skipRows(firstRow);
+  batch2.reader.skipRows(firstRow);
+
+  int64_t nextStopCheck = 0;
+  for (int64_t segmentStart = 0; segmentStart < nRows;) {
+    if (segmentStart >= nextStopCheck) {
+      if (shouldStop()) return;
+      nextStopCheck = segmentStart + kRowsPerStopCheck;
+    }
+
+    // Compare the rows both batches have
+    batch1.refill();
+    batch2.refill();
+    const int64_t segmentSize = std::min({ nRows - segmentStart, batch1.size - batch1.row, batch2.size - batch2.row });
+    const int16_t* valid1 = &batch1.valid[batch1.row];
+    const int16_t* valid2 = &batch2.valid[batch2.row];
+    const bool bothDictionary = batch1.isDictionary && batch2.isDictionary;
+    if (bothDictionary) {
+      mapping.update(batch1.reader, batch2.reader);
+    }
+
+    int64_t row = 0; // next row in the segment to compare
+    while (row < segmentSize) {
+      // Rows before validMismatch have nulls in the same places, so their
+      // values line up
+      const int64_t validMismatch = row + firstDifferentValue(&valid1[row], &valid2[row], segmentSize - row);
+      const int64_t nComparableValues = std::count(&valid1[row], &valid1[validMismatch], 1);
+
+      const uint32_t* ids1 = nullptr;
+      const uint32_t* ids2 = nullptr;
+      if (bothDictionary) {
+        mapping.translate(&batch1.indices[batch1.value], &batch2.indices[batch2.value], nComparableValues, &ids1, &ids2);
+      }
+
+      int64_t valueRow = row; // row of value `nValuesBefore`
+      int64_t nValuesBefore = 0;
+      for (int64_t i = 0; i < nComparableValues; i++) {
+        if (bothDictionary) {
+          i += firstDifferentValue(&ids1[i], &ids2[i], nComparableValues - i);
+          if (i == nComparableValues) break;
+        } else if (batch1.valueAt(batch1.value + i) == batch2.valueAt(batch2.value + i)) {
+          continue;
+        }
+
+        // Find the row of the i'th value
+        for (; nValuesBefore < i || !valid1[valueRow]; valueRow++) {
+          nValuesBefore += valid1[valueRow];
+        }
+        const parquet::ByteArray value1 = batch1.valueAt(batch1.value + i);
+        const parquet::ByteArray value2 = batch2.valueAt(batch2.value + i);
+        differences.add(firstRow + segmentStart + valueRow, &value1, &value2);
+        if (differences.done()) return;
+      }
+      batch1.value += nComparableValues;
+      batch2.value += nComparableValues;
+      row = validMismatch;
+
+      if (row < segmentSize) {
+        const parquet::ByteArray value1 = valid1[row] ? batch1.valueAt(batch1.value) : parquet::ByteArray();
+        const parquet::ByteArray value2 = valid2[row] ? batch2.valueAt(batch2.value) : parquet::ByteArray();
+        differences.add(firstRow + segmentStart + row, valid1[row] ? &value1 : nullptr, valid2[row] ? &value2 : nullptr);
+        if (differences.done()) return;
+        batch1.value += valid1[row];
+        batch2.value += valid2[row];
+        row++;
+      }
+    }
+
+    batch1.row += segmentSize;
+    batch2.row += segmentSize;
+    segmentStart += segmentSize;
+  }
+}
+
+
+/**
+ * Return true if diffDictionaryChunks() can compare these chunks, and it's
+ * worth it: both have dictionaries.
+ */
+bool canDiffDictionaryChunks(const parquet::ColumnDescriptor& column, const parquet::ColumnChunkMetaData& chunk1, const parquet::ColumnChunkMetaData& chunk2) {
+  return (
+    column.physical_type() == parquet::Type::BYTE_ARRAY
+    && column.max_definition_level() == 1
+    && column.max_repetition_level() == 0
+    && chunk1.has_dictionary_page()
+    && chunk2.has_dictionary_page()
+    && StringPageReader::canDecode(chunk1)
+    && StringPageReader::canDecode(chunk2)
+  );
+}
+
+
+/**
+ * Return the first row group whose number of rows differs between files, or
+ * nRowGroups if none does. Write the difference to `out`.
+ */
+int diffRowGroupSizes(const parquet::FileMetaData& metadata1, const parquet::FileMetaData& metadata2, int nRowGroups, std::ostream& out) {
+  for (int i = 0; i < nRowGroups; i++) {
+    const int64_t nRows = metadata1.RowGroup(i)->num_rows();
+    const int64_t nRows2 = metadata2.RowGroup(i)->num_rows();
+    if (nRows != nRows2) {
+      out
+        << "RowGroup " << i << " number of rows:" << std::endl
+        << "-" << nRows << std::endl
+        << "+" << nRows2 << std::endl;
+      return i;
+    }
+  }
+  return nRowGroups;
+}
+
+
+/**
+ * A read-only mmap() of a whole file, so threads can compare raw bytes
+ * without copying them. Empty if we can't map the file.
+ */
+class MappedFile {
+  const uint8_t* data;
+  size_t size;
+
+public:
+  MappedFile(const std::string& path) : data(nullptr), size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr != MAP_FAILED) {
+        this->data = static_cast<const uint8_t*>(addr);
+        this->size = st.st_size;
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd); // the mapping holds its own reference
+  }
+
+  ~MappedFile() {
+    if (this->data) {
+      munmap(const_cast<uint8_t*>(this->data), this->size);
+    }
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   * Return the bytes at [offset, offset + length), or nullptr if we don't
+   * have them all.
+   */
+  const uint8_t* bytes(int64_t offset, int64_t length) const {
+    if (!this->data || offset < 0 || length < 0 || static_cast<uint64_t>(offset) > this->size || static_cast<uint64_t>(length) > this->size - offset) {
+      return nullptr;
+    }
+    return this->data + offset;
+  }
+};
+
+
+/**
+ * Return the file offset of a column chunk's first page.
+ */
+int64_t columnChunkStart(const parquet::ColumnChunkMetaData& chunk) {
+  // Some writers set dictionary_page_offset to 0 when there's no dictionary
+  if (chunk.has_dictionary_page() && chunk.dictionary_page_offset() > 0 && chunk.dictionary_page_offset() < chunk.data_page_offset()) {
+    return chunk.dictionary_page_offset();
+  }
+  return chunk.data_page_offset();
+}
+
+
+/**
+ * Return true if two column chunks have the same codec, encodings and
+ * compressed bytes -- which means they hold the same values.
+ *
+ * Return false if they differ or we can't tell: the caller must decode them.
+ */
+bool columnChunkBytesEqual(const parquet::ColumnChunkMetaData& chunk1, const parquet::ColumnChunkMetaData& chunk2, const MappedFile& file1, const MappedFile& file2) {
+  if (
+    chunk1.compression() != chunk2.compression()
+    || chunk1.encodings() != chunk2.encodings()
+    || chunk1.num_values() != chunk2.num_values()
+    || chunk1.total_compressed_size() != chunk2.total_compressed_size()
+    || chunk1.total_uncompressed_size() != chunk2.total_uncompressed_size()
+  ) {
+    return false;
+  }
+
+  const int64_t size = chunk1.total_compressed_size();
+  const uint8_t* bytes1 = file1.bytes(columnChunkStart(chunk1), size);
+  const uint8_t* bytes2 = file2.bytes(columnChunkStart(chunk2), size);
+  return bytes1 && bytes2 && std::memcmp(bytes1, bytes2, size) == 0;
+}
+
+
+/**
+ * Return true if two column chunks' statistics differ: null count, distinct
+ * count, min or max (whichever both chunks record).
+ *
+ * That's only a hint that the values differ: two writers may compute
+ * statistics differently, and we want their files to compare equal.
+ */
+bool columnChunkStatisticsDiffer(const parquet::ColumnChunkMetaData& chunk1, const parquet::ColumnChunkMetaData& chunk2) {
+  if (!chunk1.is_stats_set() || !chunk2.is_stats_set()) {
+    return false;
+  }
+
+  const parquet::EncodedStatistics stats1(chunk1.statistics()->Encode());
+  const parquet::EncodedStatistics stats2(chunk2.statistics()->Encode());
+  return (
+    (stats1.has_null_count && stats2.has_null_count && stats1.null_count != stats2.null_count)
+    || (stats1.has_distinct_count && stats2.has_distinct_count && stats1.distinct_count != stats2.distinct_count)
+    || (stats1.has_min && stats2.has_min && stats1.min() != stats2.min())
+    || (stats1.has_max && stats2.has_max && stats1.max() != stats2.max())
+  );
+}
+
+
+/**
+ * List (row group, column) tasks in the order to compare them: chunks whose
+ * statistics differ first, then the rest.
+ *
+ * A chunk with different statistics probably holds a difference. Comparing
+ * it first lets us skip every later chunk as soon as we confirm it.
+ */
+std::vector<int64_t> orderTasks(const parquet::FileMetaData& metadata1, const parquet::FileMetaData& metadata2, int nRowGroups) {
+  const int nColumns = metadata1.num_columns();
+  std::vector<int64_t> suspects;
+  std::vector<int64_t> rest;
+  for (int i = 0; i < nRowGroups; i++) {
+    std::unique_ptr<parquet::RowGroupMetaData> rowGroup1(metadata1.RowGroup(i));
+    std::unique_ptr<parquet::RowGroupMetaData> rowGroup2(metadata2.RowGroup(i));
+    for (int j = 0; j < nColumns; j++) {
+      const int64_t task = static_cast<int64_t>(i) * nColumns + j;
+      if (columnChunkStatisticsDiffer(*rowGroup1->ColumnChunk(j), *rowGroup2->ColumnChunk(j))) {
+        suspects.push_back(task);
+      } else {
+        rest.push_back(task);
+      }
+    }
+  }
+  suspects.insert(suspects.end(), rest.begin(), rest.end());
+  return suspects;
+}
+
+
+/**
+ * The outcome of comparing one column chunk.
+ */
+struct ChunkDiff {
+  int64_t nDifferences; // 0 = same
+  std::vector<std::string> examples; // the first --max-differences, as text
+  std::exception_ptr error; // if comparing threw
+};
+
+
+/**
+ * Write how many cells differ in each column and row group, and in all.
+ *
+ * Unless `byRowGroup`, `results` has one entry per column, and we don't
+ * count by row group.
+ */
+void writeSummary(const parquet::FileMetaData& metadata, int nRowGroups, bool byRowGroup, const std::vector<ChunkDiff>& results, std::ostream& out) {
+  const int nColumns = metadata.num_columns();
+  std::vector<int64_t> columnCounts(nColumns, 0);
+  std::vector<int64_t> rowGroupCounts(nRowGroups, 0);
+  int64_t total = 0;
+  for (size_t task = 0; task < results.size(); task++) {
+    columnCounts[task % nColumns] += results[task].nDifferences;
+    rowGroupCounts[task / nColumns] += results[task].nDifferences; // all in "row group 0" unless byRowGroup
+    total += results[task].nDifferences;
+  }
+
+  out << "Summary:" << std::endl;
+  for (int i = 0; i < nColumns; i++) {
+    if (columnCounts[i]) {
+      out << "Column " << i << " (" << metadata.schema()->Column(i)->name() << "): " << columnCounts[i] << " different cells" << std::endl;
+    }
+  }
+  for (int i = 0; i < nRowGroups && byRowGroup; i++) {
+    if (rowGroupCounts[i]) {
+      out << "RowGroup " << i << ": " << rowGroupCounts[i] << " different cells" << std::endl;
+    }
+  }
+  out << "Total: " << total << " different cells" << std::endl;
+}
+
+
+/**
+ * Run comparison tasks on up to `options.threads` threads, in `taskOrder`
+ * order.
+ * Task `rowGroupNumber * nColumns + columnNumber` compares a (row group,
+ * column) pair of `metadata1`'s first `nRowGroups` row groups -- or, unless
+ * `byRowGroup`, task `columnNumber` compares a whole column. Tasks not in
+ * `taskOrder` are equal.
+ *
+ * Each thread calls `makeDiffTask()` once (to open its own readers; if that
+ * throws, we rethrow once every thread is done), and
+ * calls what it returns as `diffTask(rowGroupNumber, columnNumber,
+ * differences, shouldStop)` for each task it takes. Once finished tasks up to
+ * some task T hold --max-differences differences between them, threads skip
+ * (and stop) tasks after T; we still finish the ones before it, so the
+ * differences we report are always the first in (row group, column, row)
+ * order. With --summary, we compare every cell.
+ *
+ * Return 0 if every task found no differences. Otherwise, write the first
+ * --max-differences differences (and, with --summary, counts) to `out` and
+ * return 1.
+ */
+template <typename MakeDiffTask>
+int runDiffTasks(const DiffOptions& options, const parquet::FileMetaData& metadata1, int nRowGroups, bool byRowGroup, const std::vector<int64_t>& taskOrder, std::ostream& out, MakeDiffTask makeDiffTask) {
+  const int nColumns = metadata1.num_columns();
+  if (!byRowGroup) {
+    nRowGroups = 1; // one task per column
+  }
+  const int64_t nTasks = static_cast<int64_t>(nRowGroups) * nColumns;
+  // With --summary, the counts are enough: allow zero examples
+  const int64_t maxExamples = std::max(options.maxDifferences, static_cast<int64_t>(options.summary ? 0 : 1));
+  const int64_t nTaskPositions = taskOrder.size();
+  std::vector<ChunkDiff> results(nTasks);
+  std::atomic<int64_t> nextTaskPosition(0); // index into taskOrder
+  std::atomic<int64_t> lastNeededTask(nTasks); // first task by which finished tasks have maxExamples differences
+  std::map<int64_t, int64_t> nExamplesByTask; // finished tasks with differences, up to lastNeededTask
+  int64_t nExamples = 0; // sum of nExamplesByTask
+  std::mutex nExamplesMutex;
+  std::exception_ptr openError; // if a thread's makeDiffTask() threw
+  std::mutex openErrorMutex;
+
+  auto work = [&]() {
+    std::optional<decltype(makeDiffTask())> diffTask;
+    try {
+      diffTask.emplace(makeDiffTask());
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(openErrorMutex);
+      if (!openError) {
+        openError = std::current_exception();
+      }
+      nextTaskPosition = nTaskPositions; // other threads: stop
+      return;
+    }
+    for (int64_t position = nextTaskPosition++; position < nTaskPositions; position = nextTaskPosition++) {
+      const int64_t task = taskOrder[position];
+      if (task > lastNeededTask.load()) {
+        continue; // we won't report it
+      }
+      const int rowGroupNumber = task / nColumns;
+      const int columnNumber = task % nColumns;
+      ChunkDiff& chunkDiff = results[task];
+      auto shouldStop = [&]() { return lastNeededTask.load(std::memory_order_relaxed) < task; };
+      ChunkDifferences differences(
+        (byRowGroup ? "RowGroup " + std::to_string(rowGroupNumber) + ", " : std::string())
+        + "Column " + std::to_string(columnNumber),
+        maxExamples,
+        options.summary
+      );
+      try {
+        (*diffTask)(rowGroupNumber, columnNumber, differences, shouldStop);
+      } catch (...) {
+        chunkDiff.error = std::current_exception();
+        differences.addNote(""); // so we report the error in order
+      }
+
+      chunkDiff.nDifferences = differences.nDifferences();
+      chunkDiff.examples = differences.getExamples();
+      if (!options.summary && chunkDiff.nDifferences > 0) {
+        std::lock_guard<std::mutex> lock(nExamplesMutex);
+        if (task <= lastNeededTask.load()) {
+          nExamplesByTask[task] = chunkDiff.examples.size();
+          nExamples += chunkDiff.examples.size();
+        }
+        if (nExamples >= maxExamples) {
+          // Find the first task by which we have maxExamples: later tasks
+          // can't change what we report
+          int64_t nBefore = 0;
+          auto it = nExamplesByTask.begin();
+          for (; nBefore + it->second < maxExamples; ++it) {
+            nBefore += it->second;
+          }
+          lastNeededTask = it->first;
+          for (auto after = std::next(it); after != nExamplesByTask.end(); ++after) {
+            nExamples -= after->second;
+          }
+          nExamplesByTask.erase(std::next(it), nExamplesByTask.end());
+        }
+      }
+    }
+  };
+
+  int nThreads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+  nThreads = std::max(1, static_cast<int>(std::min(static_cast<int64_t>(nThreads), nTaskPositions)));
+  std::vector<std::thread> threads;
+  for (int i = 1; i < nThreads; i++) {
+    threads.emplace_back(work);
+  }
+  work(); // on this thread, too
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (openError) {
+    std::rethrow_exception(openError);
+  }
+
+  // Write the first maxExamples differences, in order
+  int64_t nWritten = 0;
+  bool anyDifferent = false;
+  for (int64_t task = 0; task < nTasks && task <= lastNeededTask.load(); task++) {
+    const ChunkDiff& chunkDiff = results[task];
+    if (chunkDiff.nDifferences == 0) continue;
+    anyDifferent = true;
+    if (chunkDiff.error && (options.summary || nWritten < maxExamples)) {
+      std::rethrow_exception(chunkDiff.error);
+    }
+    for (const std::string& example : chunkDiff.examples) {
+      if (nWritten == maxExamples) break;
+      out << example;
+      nWritten++;
+    }
+  }
+
+  if (options.summary && anyDifferent) {
+    writeSummary(metadata1, nRowGroups, byRowGroup, results, out);
+  }
+  return anyDifferent ? 1 : 0;
+}
+
+
+/**
+ * Compare the --columns column chunks in the first `nRowGroups` row groups
+ * (whose sizes match), with runDiffTasks(). Each thread opens both files.
+ *
+ * We only compare rows in `rowRange`: we skip row groups outside it without
+ * reading them, and skip rows at the start of a row group it starts in.
+ *
+ * With --loose-row-groups, ignore `nRowGroups`: each task is a whole column,
+ * read as one ColumnStream per file, and we compare the rows both files
+ * have.
+ */
+int diffColumnChunks(const DiffOptions& options, const std::string& path1, const std::string& path2, const parquet::FileMetaData& metadata1, const parquet::FileMetaData& metadata2, int nRowGroups, const std::vector<bool>& columns, Range rowRange, std::ostream& out) {
+  const int nColumns = metadata1.num_columns();
+  std::vector<int64_t> taskOrder;
+  std::vector<Range> taskRows; // [rowGroup]: rows to compare, numbered within the row group
+  if (options.looseRowGroups) {
+    // Chunk statistics don't line up when row groups don't
+    taskRows.push_back(rowRange.clip(std::min(metadata1.num_rows(), metadata2.num_rows())));
+    for (int i = 0; i < nColumns; i++) {
+      taskOrder.push_back(i);
+    }
+  } else {
+    uint64_t rowGroupStart = 0;
+    for (int i = 0; i < nRowGroups; i++) {
+      const uint64_t rowGroupStop = rowGroupStart + metadata1.RowGroup(i)->num_rows();
+      const Range rows(rowRange.clip(rowGroupStop));
+      taskRows.push_back(rows.stop > rowGroupStart ? Range(std::max(rows.start, rowGroupStart) - rowGroupStart, rows.stop - rowGroupStart) : Range(0, 0));
+      rowGroupStart = rowGroupStop;
+    }
+    taskOrder = orderTasks(metadata1, metadata2, nRowGroups);
+  }
+  // Never read unselected columns, or row groups outside rowRange
+  taskOrder.erase(std::remove_if(taskOrder.begin(), taskOrder.end(), [&](int64_t task) {
+    return !columns[task % nColumns] || taskRows[task / nColumns].size() == 0;
+  }), taskOrder.end());
+  const MappedFile file1(path1);
+  const MappedFile file2(path2);
+
+  return runDiffTasks(options, metadata1, nRowGroups, !options.looseRowGroups, taskOrder, out, [&]() {
+    std::shared_ptr<parquet::ParquetFileReader> reader1(openParquet(path1, options.reader));
+    std::shared_ptr<parquet::ParquetFileReader> reader2(openParquet(path2, options.reader));
+    return [&, reader1, reader2](int rowGroupNumber, int columnNumber, ChunkDifferences& differences, auto shouldStop) {
+      const Range rows(taskRows[rowGroupNumber]);
+      if (options.looseRowGroups) {
+        diffColumnStreams(*reader1, *reader2, columnNumber, rows.start, rows.size(), differences, shouldStop);
+        return;
+      }
+
+      // Files from the same writer often have byte-identical chunks
+      std::unique_ptr<parquet::ColumnChunkMetaData> chunkMetadata1(reader1->metadata()->RowGroup(rowGroupNumber)->ColumnChunk(columnNumber));
+      std::unique_ptr<parquet::ColumnChunkMetaData> chunkMetadata2(reader2->metadata()->RowGroup(rowGroupNumber)->ColumnChunk(columnNumber));
+      if (columnChunkBytesEqual(*chunkMetadata1, *chunkMetadata2, file1, file2)) {
+        return;
+      }
+
+      if (canDiffDictionaryChunks(*metadata1.schema()->Column(columnNumber), *chunkMetadata1, *chunkMetadata2)) {
+        diffDictionaryChunks(
+          metadata1.schema()->Column(columnNumber),
+          reader1->RowGroup(rowGroupNumber)->GetColumnPageReader(columnNumber),
+          reader2->RowGroup(rowGroupNumber)->GetColumnPageReader(columnNumber),
+          rows.start,
+          rows.size(),
+          differences,
+          shouldStop
+        );
+      } else {
+        diffColumnChunk(
+          reader1->RowGroup(rowGroupNumber)->Column(columnNumber).get(),
+          reader2->RowGroup(rowGroupNumber)->Column(columnNumber).get(),
+          rows.start,
+          rows.size(),
+          differences,
+          shouldStop
+        );
+      }
+    };
+  });
+}
+
+
+/**
+ * Compare the --columns columns of a Parquet file with an ArrowFile's (whose
+ * schema matches), with runDiffTasks(): one task per column, comparing the
+ * rows in `rowRange` that both files have. Each thread opens the Parquet
+ * file; they share the ArrowFile.
+ */
+int diffArrowColumns(const DiffOptions& options, const std::string& path1, const parquet::FileMetaData& metadata1, const ArrowFile& file2, const std::vector<bool>& columns, Range rowRange, std::ostream& out) {
+  const Range rows(rowRange.clip(std::min(metadata1.num_rows(), file2.nRows)));
+  std::vector<int64_t> taskOrder;
+  for (int i = 0; i < metadata1.num_columns(); i++) {
+    if (columns[i] && rows.size() > 0) {
+      taskOrder.push_back(i);
+    }
+  }
+
+  return runDiffTasks(options, metadata1, 0, false, taskOrder, out, [&]() {
+    std::shared_ptr<parquet::ParquetFileReader> reader1(openParquet(path1, options.reader));
+    return [&, reader1](int rowGroupNumber, int columnNumber, ChunkDifferences& differences, auto shouldStop) {
+      diffArrowColumn(*reader1, file2, columnNumber, rows.start, rows.size(), differences, shouldStop);
+    };
+  });
+}
+
+
+/**
+ * Format one CellEncoder cell the way we format column-chunk differences.
+ */
+std::string cellToString(parquet::Type::type physicalType, std::string_view cell) {
+  if (cell[0] == '\0') return "(null)";
+  const char* data = cell.data() + 1;
+  switch (physicalType) {
+#define HANDLE_FIXED_WIDTH(physicalType, CType) \
+    case physicalType: \
+      { \
+        CType value; \
+        std::memcpy(&value, data, sizeof(value)); \
+        return valueToString(value); \
+      }
+    HANDLE_FIXED_WIDTH(parquet::Type::INT32, int32_t)
+    HANDLE_FIXED_WIDTH(parquet::Type::INT64, int64_t)
+    HANDLE_FIXED_WIDTH(parquet::Type::FLOAT, float)
+    HANDLE_FIXED_WIDTH(parquet::Type::DOUBLE, double)
+#undef HANDLE_FIXED_WIDTH
+    default:
+      return std::string(cell.substr(1 + sizeof(uint32_t)));
+  }
+}
+
+
+/**
+ * Which columns make up the key (for --key), and which hold the values we
+ * compare.
+ */
+struct KeyLayout {
+  std::vector<int> keyColumns;
+  std::vector<int> valueColumns;
+  std::vector<parquet::Type::type> physicalTypes; // by column number
+  std::vector<std::string> names; // by column number
+};
+
+
+/**
+ * Parse a comma-separated list of column names: the key. Other `columns`
+ * are values.
+ *
+ * Throw if a column doesn't exist, or if a column we'd read is nested:
+ * a keyed diff compares one cell per row.
+ */
+KeyLayout parseKeyLayout(const parquet::SchemaDescriptor& schema, const std::string& columnNames, const std::vector<bool>& columns) {
+  KeyLayout layout;
+  for (int i = 0; i < schema.num_columns(); i++) {
+    layout.physicalTypes.push_back(schema.Column(i)->physical_type());
+    layout.names.push_back(schema.Column(i)->name());
+  }
+
+  std::vector<bool> isKey(schema.num_columns(), false);
+  std::istringstream in(columnNames);
+  std::string name;
+  while (std::getline(in, name, ',')) {
+    const int columnNumber = schema.ColumnIndex(name);
+    if (columnNumber < 0) {
+      throw std::runtime_error("--key column does not exist: " + name);
+    }
+    layout.keyColumns.push_back(columnNumber);
+    isKey[columnNumber] = true;
+  }
+  if (layout.keyColumns.empty()) {
+    throw std::runtime_error("--key must name at least one column");
+  }
+
+  for (int i = 0; i < schema.num_columns(); i++) {
+    if (!isKey[i] && columns[i]) {
+      layout.valueColumns.push_back(i);
+    }
+    if ((isKey[i] || columns[i]) && isNested(*schema.Column(i))) {
+      throw std::runtime_error("Column " + std::to_string(i) + " (" + schema.Column(i)->name() + ") is nested, and --key doesn't support that");
+    }
+  }
+  return layout;
+}
+
+
+/**
+ * Add every row of a file to `partitioner` on `side`. The key is the key
+ * columns' cells; the payload is the row number and the other columns'
+ * cells.
+ *
+ * Return the number of rows.
+ */
+int64_t partitionRows(parquet::ParquetFileReader& file, const KeyLayout& layout, HashPartitioner& partitioner, int side) {
+  std::vector<std::unique_ptr<CellEncoder>> keyEncoders;
+  for (int columnNumber : layout.keyColumns) {
+    keyEncoders.push_back(makeCellEncoder(file, columnNumber));
+  }
+  std::vector<std::unique_ptr<CellEncoder>> valueEncoders;
+  for (int columnNumber : layout.valueColumns) {
+    valueEncoders.push_back(makeCellEncoder(file, columnNumber));
+  }
+
+  const int64_t nRows = file.metadata()->num_rows();
+  std::string key;
+  std::string payload;
+  for (int64_t row = 0; row < nRows; row++) {
+    key.clear();
+    for (auto& encoder : keyEncoders) {
+      encoder->appendNext(key);
+    }
+    payload.assign(reinterpret_cast<const char*>(&row), sizeof(row));
+    for (auto& encoder : valueEncoders) {
+      encoder->appendNext(payload);
+    }
+    partitioner.add(side, key, payload);
+  }
+  return nRows;
+}
+
+
+/**
+ * Counts rows that differ (for --key), and keeps the first `maxExamples`
+ * differences as text: removed and changed rows in file-1 order, then
+ * added rows in file-2 order.
+ */
+class KeyDifferences {
+  const KeyLayout& layout;
+  const int64_t nRows1;
+  const int64_t maxExamples;
+  std::multimap<std::pair<int64_t, int>, std::string> examples; // by (row, column)
+
+  void addExample(int64_t row, int columnNumber, const std::string& text) {
+    if (this->maxExamples == 0) return;
+    this->examples.emplace(std::make_pair(row, columnNumber), text);
+    if (static_cast<int64_t>(this->examples.size()) > this->maxExamples) {
+      this->examples.erase(std::prev(this->examples.end()));
+    }
+  }
+
+  std::string keyToString(std::string_view key) const {
+    std::string ret("Key");
+    for (size_t i = 0; i < this->layout.keyColumns.size(); i++) {
+      const int columnNumber = this->layout.keyColumns[i];
+      const size_t size = cellSize(this->layout.physicalTypes[columnNumber], key);
+      ret += (i == 0 ? " " : ", ") + this->layout.names[columnNumber] + "=" + cellToString(this->layout.physicalTypes[columnNumber], key.substr(0, size));
+      key.remove_prefix(size);
+    }
+    return ret;
+  }
+
+  static int64_t payloadRow(std::string_view payload) {
+    int64_t row;
+    std::memcpy(&row, payload.data(), sizeof(row));
+    return row;
+  }
+
+public:
+  int64_t nRemoved;
+  int64_t nAdded;
+  int64_t nChanged;
+
+  KeyDifferences(const KeyLayout& layout_, int64_t nRows1_, int64_t maxExamples_)
+    : layout(layout_)
+    , nRows1(nRows1_)
+    , maxExamples(maxExamples_)
+    , nRemoved(0)
+    , nAdded(0)
+    , nChanged(0)
+  {
+  }
+
+  void addRemoved(std::string_view key, std::string_view payload) {
+    this->nRemoved++;
+    const int64_t row = payloadRow(payload);
+    this->addExample(row, -1, this->keyToString(key) + ":\n-row " + std::to_string(row) + "\n+(missing)\n");
+  }
+
+  void addAdded(std::string_view key, std::string_view payload) {
+    this->nAdded++;
+    const int64_t row = payloadRow(payload);
+    this->addExample(this->nRows1 + row, -1, this->keyToString(key) + ":\n-(missing)\n+row " + std::to_string(row) + "\n");
+  }
+
+  /**
+   * Compare a row's values; count and describe it if they differ.
+   */
+  void compare(std::string_view key, std::string_view payload1, std::string_view payload2) {
+    const int64_t row = payloadRow(payload1);
+    payload1.remove_prefix(sizeof(int64_t));
+    payload2.remove_prefix(sizeof(int64_t));
+    if (payload1 == payload2) return;
+
+    this->nChanged++;
+    for (int columnNumber : this->layout.valueColumns) {
+      const parquet::Type::type physicalType = this->layout.physicalTypes[columnNumber];
+      const std::string_view cell1(payload1.substr(0, cellSize(physicalType, payload1)));
+      const std::string_view cell2(payload2.substr(0, cellSize(physicalType, payload2)));
+      if (cell1 != cell2) {
+        this->addExample(
+          row,
+          columnNumber,
+          this->keyToString(key) + ", Column " + std::to_string(columnNumber) + ":\n"
+          + "-" + cellToString(physicalType, cell1) + "\n"
+          + "+" + cellToString(physicalType, cell2) + "\n"
+        );
+      }
+      payload1.remove_prefix(cell1.size());
+      payload2.remove_prefix(cell2.size());
+    }
+  }
+
+  bool any() const { return this->nRemoved || this->nAdded || this->nChanged; }
+
+  void write(std::ostream& out) const {
+    for (const auto& example : this->examples) {
+      out << example.second;
+    }
+    out
+      << "Rows removed: " << this->nRemoved << std::endl
+      << "Rows added: " << this->nAdded << std::endl
+      << "Rows changed: " << this->nChanged << std::endl;
+  }
+};
+
+
+/**
+ * Partitions per HashPartitioner (and per level of repartitioning).
+ */
+static const int kKeyPartitions = 64;
+
+
+/**
+ * Repartition at most this deep. (Each level divides a partition by
+ * kKeyPartitions: only duplicate keys could need more.)
+ */
+static const int kMaxKeyPartitionDepth = 4;
+
+
+/**
+ * Guess at the RAM an unordered_map entry costs, beyond its key and payload.
+ */
+static const int64_t kKeyTableEntryBytes = 64;
+
+
+/**
+ * Match one partition's rows by key and compare them.
+ *
+ * We load file 1's rows into a hash table, then stream file 2's rows past
+ * it, adding the keys of file 2's unmatched rows to the table so we catch
+ * duplicates. So the table may grow to both sides' records: if they won't
+ * fit in `maxBytes`, we split the partition (with a different hash) and
+ * recurse.
+ *
+ * `partitioner` may hold up to `maxBytes` of buffers while the table holds
+ * up to `maxBytes`. Before splitting, we spill its buffers, so the
+ * sub-partitioner's buffers take their place: at any depth, RAM stays
+ * within 2 * `maxBytes`.
+ *
+ * Throw if a key appears twice in the same file.
+ */
+void diffKeyPartition(HashPartitioner& partitioner, int partition, int depth, int64_t maxBytes, KeyDifferences& differences) {
+  const int64_t nBytes = (
+    partitioner.nBytes(partition, 0)
+    + partitioner.nBytes(partition, 1)
+    + (partitioner.nRecords(partition, 0) + partitioner.nRecords(partition, 1)) * kKeyTableEntryBytes
+  );
+  std::string_view key;
+  std::string_view payload;
+
+  if (maxBytes >= 0 && nBytes > maxBytes && depth < kMaxKeyPartitionDepth) {
+    partitioner.spill();
+    HashPartitioner subPartitioner(kKeyPartitions, depth + 1, maxBytes);
+    for (int side = 0; side < 2; side++) {
+      while (partitioner.next(partition, side, &key, &payload)) {
+        subPartitioner.add(side, key, payload);
+      }
+    }
+    for (int i = 0; i < subPartitioner.nPartitions(); i++) {
+      diffKeyPartition(subPartitioner, i, depth + 1, maxBytes, differences);
+    }
+    return;
+  }
+
+  struct Row {
+    std::string_view payload; // empty for file 2's rows
+    bool matched; // true for file 2's rows
+  };
+  std::string arena; // every key and payload in `rows`; never reallocates
+  arena.reserve(partitioner.nBytes(partition, 0) + partitioner.nBytes(partition, 1));
+  std::unordered_map<std::string_view, Row> rows;
+  rows.reserve(partitioner.nRecords(partition, 0) + partitioner.nRecords(partition, 1));
+  while (partitioner.next(partition, 0, &key, &payload)) {
+    const size_t offset = arena.size();
+    arena.append(key);
+    arena.append(payload);
+    const std::string_view storedKey(arena.data() + offset, key.size());
+    const std::string_view storedPayload(arena.data() + offset + key.size(), payload.size());
+    if (!rows.emplace(storedKey, Row { .payload = storedPayload, .matched = false }).second) {
+      throw std::runtime_error("--key is not unique in file 1");
+    }
+  }
+
+  while (partitioner.next(partition, 1, &key, &payload)) {
+    auto it = rows.find(key);
+    if (it == rows.end()) {
+      // Remember the key, to catch duplicates
+      const size_t offset = arena.size();
+      arena.append(key);
+      rows.emplace(std::string_view(arena.data() + offset, key.size()), Row { .payload = std::string_view(), .matched = true });
+      differences.addAdded(key, payload);
+    } else if (it->second.matched) {
+      throw std::runtime_error("--key is not unique in file 2");
+    } else {
+      it->second.matched = true;
+      differences.compare(key, it->second.payload, payload);
+    }
+  }
+
+  for (const auto& [rowKey, row] : rows) {
+    if (!row.matched) {
+      differences.addRemoved(rowKey, row.payload);
+    }
+  }
+}
+
+
+/**
+ * Return 0 if both files hold the same rows, in any order, matching rows by
+ * their --key columns; or write the differences and return 1.
+ *
+ * We hash-partition both files' rows by key (in --key-memory bytes, spilling
+ * partitions to temporary files beyond that), then compare one partition at
+ * a time. Time is linear in the number of rows.
+ */
+int diffKeyed(const DiffOptions& options, parquet::ParquetFileReader& reader1, parquet::ParquetFileReader& reader2, const std::vector<bool>& columns, std::ostream& out) {
+  if (!options.rowRange.empty()) {
+    throw std::runtime_error("--row-range does not work with --key");
+  }
+
+  const KeyLayout layout(parseKeyLayout(*reader1.metadata()->schema(), options.key, columns));
+  // Half the memory buffers partitions; half holds one partition's table
+  const int64_t maxBytes = options.keyMemory >= 0 ? options.keyMemory / 2 : -1;
+
+  HashPartitioner partitioner(kKeyPartitions, 0, maxBytes);
+  const int64_t nRows1 = partitionRows(reader1, layout, partitioner, 0);
+  partitionRows(reader2, layout, partitioner, 1);
+
+  KeyDifferences differences(layout, nRows1, std::max(options.maxDifferences, static_cast<int64_t>(0)));
+  for (int i = 0; i < partitioner.nPartitions(); i++) {
+    diffKeyPartition(partitioner, i, 0, maxBytes, differences);
+  }
+
+  if (differences.any()) {
+    differences.write(out);
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Parse --columns: return whether to compare each column.
+ *
+ * Throw if a column doesn't exist.
+ */
+std::vector<bool> parseColumns(const parquet::SchemaDescriptor& schema, const std::string& columnNames) {
+  if (columnNames.empty()) {
+    return std::vector<bool>(schema.num_columns(), true);
+  }
+
+  std::vector<bool> columns(schema.num_columns(), false);
+  std::istringstream in(columnNames);
+  std::string name;
+  while (std::getline(in, name, ',')) {
+    const int columnNumber = schema.ColumnIndex(name);
+    if (columnNumber < 0) {
+      throw std::runtime_error("--columns column does not exist: " + name);
+    }
+    columns[columnNumber] = true;
+  }
+  return columns;
+}
+
+
+/**
+ * Parse --row-range: "" means every row.
+ *
+ * Throw if it isn't a range.
+ */
+Range parseRowRange(const std::string& value) {
+  if (value.empty()) {
+    return Range();
+  }
+  auto [range, ec] = parse_range(&*value.cbegin(), &*value.cend());
+  if (ec != std::errc()) {
+    throw std::runtime_error("--row-range does not look like '123-234': " + std::make_error_code(ec).message());
+  }
+  return range;
+}
+
+
+/**
+ * Return 0 iff a Parquet file and an Arrow IPC file hold the same values, or
+ * 1 if they differ (for --arrow).
+ *
+ * If returning 1, write a difference in text form to `out`.
+ *
+ * We stream the Parquet file column by column, and read the Arrow file
+ * through a memory map, without copying it.
+ */
+static int
+diffArrow(const std::string& path1, const std::string& path2, const DiffOptions& options, std::ostream& out)
+{
+  if (!options.key.empty()) {
+    throw std::runtime_error("--key does not work with --arrow");
+  }
+
+  std::unique_ptr<parquet::ParquetFileReader> reader1(openParquet(path1, options.reader));
+  const ArrowFile file2(path2);
+  const auto metadata1 = reader1->metadata();
+
+  if (diffArrowSchema(*metadata1, *file2.schema, out)) {
+    return 1;
+  }
+
+  // Report a value's difference before the files' lengths' difference
+  if (diffArrowColumns(options, path1, *metadata1, file2, parseColumns(*metadata1->schema(), options.columns), parseRowRange(options.rowRange), out)) {
+    return 1;
+  }
+  if (metadata1->num_rows() != file2.nRows) {
+    out << "Number of rows:" << std::endl << "-" << metadata1->num_rows() << std::endl << "+" << file2.nRows << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Return 0 iff both Parquet files are equivalent or 1 if they differ.
+ *
+ * If returning 1, write a difference in text form to `out`.
+ */
+static int
+diffParquetFiles(const std::string& path1, const std::string& path2, const DiffOptions& options, std::ostream& out)
+{
+  std::unique_ptr<parquet::ParquetFileReader> reader1(openParquet(path1, options.reader));
+  std::unique_ptr<parquet::ParquetFileReader> reader2(openParquet(path2, options.reader));
+
+  const auto metadata1 = reader1->metadata();
+  const auto metadata2 = reader2->metadata();
+
+  if (diffSchema(*(metadata1->schema()), *(metadata2->schema()), out)) {
+    return 1;
+  }
+
+  const std::vector<bool> columns(parseColumns(*metadata1->schema(), options.columns));
+  if (!options.key.empty()) {
+    return diffKeyed(options, *reader1, *reader2, columns, out);
+  }
+
+  const Range rowRange(parseRowRange(options.rowRange));
+  if (options.looseRowGroups) {
+    // Report a value's difference before the files' lengths' difference
+    if (diffColumnChunks(options, path1, path2, *metadata1, *metadata2, 0, columns, rowRange, out)) {
+      return 1;
+    }
+    if (metadata1->num_rows() != metadata2->num_rows()) {
+      out << "Number of rows:" << std::endl << "-" << metadata1->num_rows() << std::endl << "+" << metadata2->num_rows() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  const int nRowGroups = metadata1->num_row_groups();
+  if (metadata2->num_row_groups() != nRowGroups) {
+    out << "Number of row groups:" << std::endl << "-" << nRowGroups << std::endl << "+" << metadata2->num_row_groups() << std::endl;
+    return 1;
+  }
+
+  // Report a chunk's difference before a later row group's size difference
+  std::ostringstream sizeDifference;
+  const int nSameSizeRowGroups = diffRowGroupSizes(*metadata1, *metadata2, nRowGroups, sizeDifference);
+
+  if (diffColumnChunks(options, path1, path2, *metadata1, *metadata2, nSameSizeRowGroups, columns, rowRange, out)) {
+    return 1;
+  }
+  if (nSameSizeRowGroups < nRowGroups) {
+    out << sizeDifference.str();
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int diff(const std::string& path1, const std::string& path2, const DiffOptions& options, std::ostream& out)
+{
+  return options.arrow ? diffArrow(path1, path2, options, out) : diffParquetFiles(path1, path2, options, out);
+}
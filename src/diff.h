@@ -0,0 +1,37 @@
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+ * Comparing two files, as parquet-diff does.
+ *
+ * Include common.h first: DiffOptions holds its ReaderOptions.
+ */
+
+/**
+ * How to compare two files: parquet-diff's flags.
+ */
+struct DiffOptions {
+  int threads = 0; // number of column chunks to compare at once (0 means one per CPU)
+  int64_t maxDifferences = 1; // write at most this many differing cells
+  bool summary = false; // compare every cell, and write how many differ in each column and row group
+  bool looseRowGroups = false; // compare each column's rows across row-group boundaries
+  std::string key; // comma-separated columns that identify a row ("" to compare rows in order)
+  int64_t keyMemory = 256 * 1024 * 1024; // with `key`, bytes of rows to hold in RAM (-1 for no limit)
+  std::string columns; // comma-separated columns to compare ("" for all)
+  std::string rowRange; // "123-234": [start, end) range of rows to compare ("" for all)
+  bool arrow = false; // file 2 is an Arrow IPC file: compare its values with file 1's
+  ReaderOptions reader;
+};
+
+/**
+ * Return 0 iff two files hold the same values, or 1 if they differ.
+ *
+ * If returning 1, write the first differences in text form to `out`.
+ *
+ * Throw parquet::ParquetException if a file isn't valid Parquet (or we
+ * can't read or decode part of it), or std::runtime_error if we can't
+ * compare the files (say, because an option doesn't apply to them).
+ * parquet-diff exits 2 on either.
+ */
+int diff(const std::string& path1, const std::string& path2, const DiffOptions& options, std::ostream& out);
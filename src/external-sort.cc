@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "common.h"
+#include "external-sort.h"
+
+
+/** Orders a min-heap of runs by their current keys. */
+struct SpilledRunGreater {
+  template<typename Run>
+  bool operator()(const Run* a, const Run* b) const {
+    return a->key > b->key;
+  }
+};
+
+
+/**
+ * Merge runs when we have this many, so we don't run out of file descriptors.
+ */
+static const size_t kMaxSpilledRuns = 64;
+
+
+ExternalSorter::ExternalSorter(int64_t maxBytes_)
+  : maxBytes(maxBytes_)
+  , entryCursor(0)
+{
+}
+
+ExternalSorter::~ExternalSorter()
+{
+  for (const auto& run : this->spilledRuns) {
+    fclose(run->fp);
+  }
+}
+
+void
+ExternalSorter::add(std::string_view key, std::string_view payload)
+{
+  this->entries.push_back(Entry {
+    .offset = this->arena.size(),
+    .keySize = static_cast<uint32_t>(key.size()),
+    .payloadSize = static_cast<uint32_t>(payload.size())
+  });
+  this->arena.append(key);
+  this->arena.append(payload);
+
+  if (
+    this->maxBytes >= 0
+    && static_cast<int64_t>(this->arena.size() + this->entries.size() * sizeof(Entry)) > this->maxBytes
+  ) {
+    this->spillRun();
+  }
+}
+
+void
+ExternalSorter::sortRun()
+{
+  std::sort(this->entries.begin(), this->entries.end(), [this](const Entry& a, const Entry& b) {
+    return this->entryKey(a) < this->entryKey(b);
+  });
+}
+
+static FILE*
+createRunFile()
+{
+  int fd = openTemporaryFile();
+  FILE* fp = fd == -1 ? nullptr : fdopen(fd, "w+");
+  if (!fp) {
+    throw std::runtime_error(std::string("Failed to create temporary file for sorting: ") + std::strerror(errno));
+  }
+  return fp;
+}
+
+static void
+writeRecord(FILE* fp, std::string_view key, std::string_view payload)
+{
+  const uint32_t keySize = key.size();
+  const uint32_t payloadSize = payload.size();
+  fwrite_unlocked(&keySize, sizeof(keySize), 1, fp);
+  fwrite_unlocked(&payloadSize, sizeof(payloadSize), 1, fp);
+  fwrite_unlocked(key.data(), 1, keySize, fp);
+  fwrite_unlocked(payload.data(), 1, payloadSize, fp);
+}
+
+static void
+finishRunFile(FILE* fp)
+{
+  if (fflush(fp) != 0 || ferror(fp)) {
+    throw std::runtime_error(std::string("Failed to write temporary file for sorting: ") + std::strerror(errno));
+  }
+  rewind(fp);
+}
+
+void
+ExternalSorter::spillRun()
+{
+  this->sortRun();
+
+  FILE* fp = createRunFile();
+  for (const Entry& entry : this->entries) {
+    writeRecord(fp, this->entryKey(entry), this->entryPayload(entry));
+  }
+  finishRunFile(fp);
+  this->spilledRuns.push_back(std::make_unique<SpilledRun>(SpilledRun { .fp = fp, .key = "", .payload = "" }));
+
+  // Free the RAM, not just the contents
+  std::string().swap(this->arena);
+  std::vector<Entry>().swap(this->entries);
+
+  if (this->spilledRuns.size() >= kMaxSpilledRuns) {
+    this->mergeSpilledRuns();
+  }
+}
+
+void
+ExternalSorter::mergeSpilledRuns()
+{
+  std::vector<SpilledRun*> runs;
+  for (const auto& run : this->spilledRuns) {
+    if (readRecord(*run)) {
+      runs.push_back(run.get());
+    }
+  }
+  std::make_heap(runs.begin(), runs.end(), SpilledRunGreater());
+
+  FILE* fp = createRunFile();
+  while (!runs.empty()) {
+    std::pop_heap(runs.begin(), runs.end(), SpilledRunGreater());
+    SpilledRun* run = runs.back();
+    writeRecord(fp, run->key, run->payload);
+    if (readRecord(*run)) {
+      std::push_heap(runs.begin(), runs.end(), SpilledRunGreater());
+    } else {
+      runs.pop_back();
+    }
+  }
+  finishRunFile(fp);
+
+  for (const auto& run : this->spilledRuns) {
+    fclose(run->fp);
+  }
+  this->spilledRuns.clear();
+  this->spilledRuns.push_back(std::make_unique<SpilledRun>(SpilledRun { .fp = fp, .key = "", .payload = "" }));
+}
+
+bool
+ExternalSorter::readRecord(SpilledRun& run)
+{
+  uint32_t keySize;
+  uint32_t payloadSize;
+  if (fread_unlocked(&keySize, sizeof(keySize), 1, run.fp) != 1) {
+    return false; // end of run
+  }
+  if (fread_unlocked(&payloadSize, sizeof(payloadSize), 1, run.fp) != 1) {
+    throw std::runtime_error("Failed to read temporary file for sorting");
+  }
+  run.key.resize(keySize);
+  run.payload.resize(payloadSize);
+  if (
+    fread_unlocked(run.key.data(), 1, keySize, run.fp) != keySize
+    || fread_unlocked(run.payload.data(), 1, payloadSize, run.fp) != payloadSize
+  ) {
+    throw std::runtime_error("Failed to read temporary file for sorting");
+  }
+  return true;
+}
+
+void
+ExternalSorter::finish()
+{
+  this->sortRun();
+
+  for (const auto& run : this->spilledRuns) {
+    if (readRecord(*run)) {
+      this->heap.push_back(run.get());
+    }
+  }
+  std::make_heap(this->heap.begin(), this->heap.end(), SpilledRunGreater());
+}
+
+bool
+ExternalSorter::next(std::string_view* payload)
+{
+  const bool haveEntry = this->entryCursor < this->entries.size();
+  if (this->heap.empty() && !haveEntry) {
+    return false;
+  }
+
+  if (
+    haveEntry
+    && (this->heap.empty() || this->entryKey(this->entries[this->entryCursor]) <= this->heap.front()->key)
+  ) {
+    *payload = this->entryPayload(this->entries[this->entryCursor]);
+    this->entryCursor++;
+    return true;
+  }
+
+  std::pop_heap(this->heap.begin(), this->heap.end(), SpilledRunGreater());
+  SpilledRun* run = this->heap.back();
+  this->heap.pop_back();
+
+  // Take the payload, so we can read the run's next record now
+  this->currentPayload.swap(run->payload);
+  *payload = this->currentPayload;
+  if (readRecord(*run)) {
+    this->heap.push_back(run);
+    std::push_heap(this->heap.begin(), this->heap.end(), SpilledRunGreater());
+  }
+  return true;
+}
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Sorts (key, payload) records by key (memcmp order), in bounded memory.
+ *
+ * add() appends records to an in-memory run. When the run exceeds
+ * `maxBytes`, we sort it and spill it to an unlinked temporary file. (Every
+ * 64 spilled runs, we merge them into one.) finish() sorts the last run; then
+ * next() merges all runs, yielding payloads in key order.
+ *
+ * Equal keys come out in an unspecified order: make keys unique (e.g., by
+ * appending a row number) for a stable sort.
+ */
+class ExternalSorter {
+public:
+  /**
+   * Create a sorter that holds at most about `maxBytes` of records in RAM.
+   */
+  ExternalSorter(int64_t maxBytes);
+  ~ExternalSorter();
+
+  void add(std::string_view key, std::string_view payload);
+
+  /**
+   * Stop adding; start merging.
+   */
+  void finish();
+
+  /**
+   * Set `*payload` to the next payload in key order, and return true; or
+   * return false if there are no more.
+   *
+   * `*payload` is valid until the next call.
+   */
+  bool next(std::string_view* payload);
+
+  /**
+   * Return the number of runs we spilled to disk.
+   */
+  size_t nSpilledRuns() const { return this->spilledRuns.size(); }
+
+private:
+  struct Entry {
+    size_t offset; // into `arena`
+    uint32_t keySize;
+    uint32_t payloadSize;
+  };
+
+  struct SpilledRun {
+    FILE* fp; // unlinked temporary file
+    std::string key; // current record
+    std::string payload; // current record
+  };
+
+  const int64_t maxBytes;
+  std::string arena; // key and payload of every in-memory record
+  std::vector<Entry> entries; // in-memory records
+  size_t entryCursor; // next entry to merge
+  std::vector<std::unique_ptr<SpilledRun>> spilledRuns;
+  std::vector<SpilledRun*> heap; // runs with a current record; min-heap by key
+  std::string currentPayload; // what next() returned, when it came from a SpilledRun
+
+  std::string_view entryKey(const Entry& entry) const {
+    return std::string_view(this->arena.data() + entry.offset, entry.keySize);
+  }
+
+  std::string_view entryPayload(const Entry& entry) const {
+    return std::string_view(this->arena.data() + entry.offset + entry.keySize, entry.payloadSize);
+  }
+
+  void sortRun();
+  void spillRun();
+  void mergeSpilledRuns();
+  static bool readRecord(SpilledRun& run);
+};
@@ -0,0 +1,127 @@
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include "common.h"
+#include "hash-partition.h"
+#include "hyperloglog.h"
+
+
+HashPartitioner::HashPartitioner(int nPartitions, uint64_t seed_, int64_t maxBytes_)
+  : seed(seed_)
+  , maxBytes(maxBytes_)
+  , partitions(nPartitions * 2, Partition { .buffer = "", .fp = nullptr, .nRecords = 0, .nBytes = 0, .reading = false, .bufferCursor = 0 })
+  , bufferedBytes(0)
+  , spillCount(0)
+{
+}
+
+HashPartitioner::~HashPartitioner()
+{
+  for (const Partition& partition : this->partitions) {
+    if (partition.fp) {
+      fclose(partition.fp);
+    }
+  }
+}
+
+static void
+appendRecord(std::string& buffer, std::string_view key, std::string_view payload)
+{
+  const uint32_t keySize = key.size();
+  const uint32_t payloadSize = payload.size();
+  buffer.append(reinterpret_cast<const char*>(&keySize), sizeof(keySize));
+  buffer.append(reinterpret_cast<const char*>(&payloadSize), sizeof(payloadSize));
+  buffer.append(key);
+  buffer.append(payload);
+}
+
+void
+HashPartitioner::add(int side, std::string_view key, std::string_view payload)
+{
+  const uint64_t hash = mixHash(std::hash<std::string_view>()(key) ^ this->seed);
+  Partition& partition = this->partitions[(hash % this->nPartitions()) * 2 + side];
+  const size_t sizeBefore = partition.buffer.size();
+  appendRecord(partition.buffer, key, payload);
+  partition.nRecords++;
+  partition.nBytes += key.size() + payload.size();
+  this->bufferedBytes += partition.buffer.size() - sizeBefore;
+
+  if (this->maxBytes >= 0 && this->bufferedBytes > this->maxBytes) {
+    this->spill();
+  }
+}
+
+void
+HashPartitioner::spill()
+{
+  for (Partition& partition : this->partitions) {
+    if (partition.buffer.empty() || partition.reading) continue;
+
+    if (!partition.fp) {
+      int fd = openTemporaryFile();
+      partition.fp = fd == -1 ? nullptr : fdopen(fd, "w+");
+      if (!partition.fp) {
+        throw std::runtime_error(std::string("Failed to create temporary file for partitioning: ") + std::strerror(errno));
+      }
+    }
+    if (fwrite_unlocked(partition.buffer.data(), 1, partition.buffer.size(), partition.fp) != partition.buffer.size()) {
+      throw std::runtime_error(std::string("Failed to write temporary file for partitioning: ") + std::strerror(errno));
+    }
+    this->bufferedBytes -= partition.buffer.size();
+    std::string().swap(partition.buffer); // free the RAM, not just the contents
+  }
+  this->spillCount++;
+}
+
+bool
+HashPartitioner::next(int partitionIndex, int side, std::string_view* key, std::string_view* payload)
+{
+  Partition& partition = this->partitions[partitionIndex * 2 + side];
+  if (!partition.reading) {
+    partition.reading = true;
+    if (partition.fp && (fflush(partition.fp) != 0 || ferror(partition.fp))) {
+      throw std::runtime_error(std::string("Failed to write temporary file for partitioning: ") + std::strerror(errno));
+    }
+    if (partition.fp) {
+      rewind(partition.fp);
+    }
+  }
+
+  // Spilled records come first: we added them first
+  if (partition.fp) {
+    uint32_t sizes[2];
+    if (fread_unlocked(sizes, sizeof(uint32_t), 2, partition.fp) == 2) {
+      this->currentKey.resize(sizes[0]);
+      this->currentPayload.resize(sizes[1]);
+      if (
+        fread_unlocked(this->currentKey.data(), 1, sizes[0], partition.fp) != sizes[0]
+        || fread_unlocked(this->currentPayload.data(), 1, sizes[1], partition.fp) != sizes[1]
+      ) {
+        throw std::runtime_error("Failed to read temporary file for partitioning");
+      }
+      *key = this->currentKey;
+      *payload = this->currentPayload;
+      return true;
+    }
+    fclose(partition.fp); // the kernel deletes it
+    partition.fp = nullptr;
+  }
+
+  if (partition.bufferCursor < partition.buffer.size()) {
+    uint32_t sizes[2];
+    std::memcpy(sizes, partition.buffer.data() + partition.bufferCursor, sizeof(sizes));
+    const char* data = partition.buffer.data() + partition.bufferCursor + sizeof(sizes);
+    *key = std::string_view(data, sizes[0]);
+    *payload = std::string_view(data + sizes[0], sizes[1]);
+    partition.bufferCursor += sizeof(sizes) + sizes[0] + sizes[1];
+    return true;
+  }
+
+  this->bufferedBytes -= partition.buffer.size();
+  std::string().swap(partition.buffer);
+  partition.bufferCursor = 0;
+  return false;
+}
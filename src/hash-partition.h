@@ -0,0 +1,84 @@
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Groups (key, payload) records from two sides (say, two files) by a hash of
+ * their keys, in bounded memory.
+ *
+ * add() appends a record to its partition's in-memory buffer. When all
+ * buffers together exceed `maxBytes`, we append each buffer to its
+ * partition's unlinked temporary file and empty it. Then next() yields one
+ * side of one partition's records, in the order we added them.
+ *
+ * Records with equal keys always land in the same partition. To split a
+ * partition that is too big, feed its records to a HashPartitioner with a
+ * different `seed`.
+ */
+class HashPartitioner {
+public:
+  /**
+   * Create a partitioner that holds at most about `maxBytes` of records in
+   * RAM (-1 for no limit).
+   */
+  HashPartitioner(int nPartitions, uint64_t seed, int64_t maxBytes);
+  ~HashPartitioner();
+
+  HashPartitioner(const HashPartitioner&) = delete;
+  HashPartitioner& operator=(const HashPartitioner&) = delete;
+
+  void add(int side, std::string_view key, std::string_view payload);
+
+  int nPartitions() const { return this->partitions.size() / 2; }
+
+  /**
+   * Return the number of records on one side of a partition.
+   */
+  int64_t nRecords(int partition, int side) const { return this->partitions[partition * 2 + side].nRecords; }
+
+  /**
+   * Return the number of key and payload bytes on one side of a partition.
+   */
+  int64_t nBytes(int partition, int side) const { return this->partitions[partition * 2 + side].nBytes; }
+
+  /**
+   * Set `*key` and `*payload` to the next record on one side of a partition,
+   * and return true; or return false if there are no more.
+   *
+   * `*key` and `*payload` are valid until the next call. Read one
+   * (partition, side) at a time; reading frees its RAM.
+   */
+  bool next(int partition, int side, std::string_view* key, std::string_view* payload);
+
+  /**
+   * Append every buffer we aren't reading to its partition's temporary
+   * file, freeing its RAM. add() calls this when buffers exceed `maxBytes`;
+   * call it yourself to free RAM for something else.
+   */
+  void spill();
+
+  /**
+   * Return the number of times we spilled buffers to disk.
+   */
+  int nSpills() const { return this->spillCount; }
+
+private:
+  struct Partition {
+    std::string buffer; // records not yet spilled, as in the file
+    FILE* fp; // unlinked temporary file, or nullptr if we never spilled
+    int64_t nRecords;
+    int64_t nBytes;
+    bool reading; // true once next() has started
+    size_t bufferCursor; // next record in `buffer`, once reading
+  };
+
+  const uint64_t seed;
+  const int64_t maxBytes;
+  std::vector<Partition> partitions; // [partition * 2 + side]
+  int64_t bufferedBytes; // sum of buffer sizes
+  int spillCount;
+  std::string currentKey; // what next() returned, when it came from a file
+  std::string currentPayload;
+};
@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <parquet/types.h>
+
+/*
+ * Decoders that read values straight out of a decompressed Parquet page.
+ *
+ * parquet::TypedColumnReader::ReadBatch() decodes every value into a
+ * caller-supplied array, which we then copy again. These decoders hand out
+ * one value at a time, reading it from the page buffer itself. They cover the
+ * encodings real-world writers use for flat columns:
+ *
+ * * PLAIN (every physical type we print)
+ * * RLE/bit-packed hybrid (definition levels and dictionary indices)
+ * * DELTA_BINARY_PACKED (INT32 and INT64)
+ *
+ * Bit-packed values are unpacked 8 at a time (the Parquet group size), with a
+ * fixed-trip-count loop the compiler unrolls and vectorizes. We don't use
+ * intrinsics: our static binaries run on whatever CPU the user has.
+ *
+ * Every decoder throws std::runtime_error on truncated input, rather than
+ * reading out of bounds.
+ *
+ * See https://github.com/apache/parquet-format/blob/master/Encodings.md
+ */
+
+
+[[noreturn]] static inline void throwCorruptPage(const char* what)
+{
+  throw std::runtime_error(std::string("Corrupt Parquet page: ") + what);
+}
+
+
+/**
+ * Read a ULEB128 varint at `*p`, advancing `*p`.
+ */
+static inline uint64_t readUleb128(const uint8_t** p, const uint8_t* end)
+{
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*p >= end) throwCorruptPage("truncated varint");
+    uint8_t byte = *(*p)++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+  throwCorruptPage("varint too long");
+}
+
+
+static inline int64_t readZigZagVarint(const uint8_t** p, const uint8_t* end)
+{
+  uint64_t value = readUleb128(p, end);
+  return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+
+/**
+ * Unpack 8 little-endian bit-packed values of `bitWidth` bits each.
+ *
+ * `in` must hold at least `bitWidth` readable bytes; `avail` may be smaller
+ * if the writer truncated the final group, in which case missing bits read
+ * as 0.
+ */
+template<typename UInt>
+static inline void unpack8(const uint8_t* in, size_t avail, int bitWidth, UInt* out)
+{
+  static_assert(std::is_unsigned<UInt>::value);
+  // Copy into zero-padded scratch, so the word loads below never overrun
+  // the page and the loop has no bounds checks.
+  uint8_t buf[sizeof(UInt) * 8 + 16] = {};
+  std::memcpy(buf, in, std::min(avail, static_cast<size_t>(bitWidth)));
+
+  const uint64_t mask = bitWidth >= 64 ? ~uint64_t(0) : (uint64_t(1) << bitWidth) - 1;
+  for (int i = 0; i < 8; i++) {
+    const int bit = i * bitWidth;
+    const int shift = bit & 7;
+    uint64_t lo;
+    std::memcpy(&lo, buf + (bit >> 3), 8);
+    uint64_t value = lo >> shift;
+    if (sizeof(UInt) == 8 && shift + bitWidth > 64) {
+      uint64_t hi;
+      std::memcpy(&hi, buf + (bit >> 3) + 8, 8);
+      value |= hi << (64 - shift);
+    }
+    out[i] = static_cast<UInt>(value & mask);
+  }
+}
+
+
+/**
+ * Unpack 8 little-endian bit-packed values of `BitWidth` (at most 32) bits.
+ *
+ * `in` must hold at least `BitWidth + 8` readable bytes: we load a word
+ * per value, straight from the input. With the width a constant, the loop
+ * unrolls into eight load-shift-mask steps.
+ */
+template<int BitWidth>
+static inline void unpack8Fixed(const uint8_t* in, uint32_t* out)
+{
+  constexpr uint64_t mask = (uint64_t(1) << BitWidth) - 1;
+  for (int i = 0; i < 8; i++) {
+    const int bit = i * BitWidth;
+    uint64_t word;
+    std::memcpy(&word, in + (bit >> 3), 8);
+    out[i] = static_cast<uint32_t>((word >> (bit & 7)) & mask);
+  }
+}
+
+
+typedef void (*Unpack8Function)(const uint8_t* in, uint32_t* out);
+
+
+template<size_t... BitWidths>
+static constexpr std::array<Unpack8Function, sizeof...(BitWidths)> makeUnpack8Functions(std::index_sequence<BitWidths...>)
+{
+  return { &unpack8Fixed<BitWidths>... };
+}
+
+
+/**
+ * unpack8Fixed<bitWidth>, indexed by bitWidth (0 to 32).
+ */
+static constexpr std::array<Unpack8Function, 33> kUnpack8Functions = makeUnpack8Functions(std::make_index_sequence<33>());
+
+
+/**
+ * Decoder for the RLE/bit-packed hybrid encoding.
+ *
+ * Used for definition levels (bit width 1, for nullable flat columns) and
+ * for dictionary indices.
+ */
+class RleBitPackedDecoder {
+  const uint8_t* p;
+  const uint8_t* end;
+  int bitWidth;
+  uint32_t repeatCount; // values left in current RLE run
+  uint32_t repeatValue;
+  uint32_t literalCount; // values left in current bit-packed run, including `group`
+  uint32_t group[8]; // current unpacked group of a bit-packed run
+  int groupCursor; // [0, 8]
+  Unpack8Function unpackFixed; // for bitWidth
+
+public:
+  RleBitPackedDecoder() : p(nullptr), end(nullptr), bitWidth(0), repeatCount(0), repeatValue(0), literalCount(0), groupCursor(8), unpackFixed(kUnpack8Functions[0]) {}
+
+  void reset(const uint8_t* data, size_t size, int bitWidth_) {
+    if (bitWidth_ < 0 || bitWidth_ > 32) throwCorruptPage("invalid bit width");
+    this->p = data;
+    this->end = data + size;
+    this->bitWidth = bitWidth_;
+    this->unpackFixed = kUnpack8Functions[bitWidth_];
+    this->repeatCount = 0;
+    this->literalCount = 0;
+    this->groupCursor = 8;
+  }
+
+  /**
+   * Decode `n` values into `out`.
+   */
+  template<typename Int>
+  void decode(Int* out, int n) {
+    while (n > 0) {
+      if (this->repeatCount > 0) {
+        int count = std::min(static_cast<uint32_t>(n), this->repeatCount);
+        std::fill(out, out + count, static_cast<Int>(this->repeatValue));
+        out += count;
+        n -= count;
+        this->repeatCount -= count;
+      } else if (this->literalCount > 0) {
+        if (this->groupCursor == 8 && n >= 8 && this->literalCount >= 8) {
+          // Fast path: unpack whole groups straight into `out`
+          while (n >= 8 && this->literalCount >= 8) {
+            if constexpr (std::is_same<Int, uint32_t>::value) {
+              // Far from the end of the page, unpack without bounds checks
+              if (this->end - this->p >= this->bitWidth + 8) {
+                this->unpackFixed(this->p, out);
+                this->p += this->bitWidth;
+                out += 8;
+                n -= 8;
+                this->literalCount -= 8;
+                continue;
+              }
+            }
+            uint32_t unpacked[8];
+            this->unpackGroup(unpacked);
+            std::copy(unpacked, unpacked + 8, out);
+            out += 8;
+            n -= 8;
+            this->literalCount -= 8;
+          }
+        } else {
+          if (this->groupCursor == 8) {
+            this->unpackGroup(this->group);
+            this->groupCursor = 0;
+          }
+          *out++ = static_cast<Int>(this->group[this->groupCursor++]);
+          n--;
+          this->literalCount--;
+        }
+      } else {
+        this->readRunHeader();
+      }
+    }
+  }
+
+  uint32_t next() {
+    uint32_t value;
+    this->decode(&value, 1);
+    return value;
+  }
+
+  void skip(int64_t n) {
+    while (n > 0) {
+      if (this->repeatCount > 0) {
+        uint32_t count = std::min(static_cast<uint64_t>(n), static_cast<uint64_t>(this->repeatCount));
+        n -= count;
+        this->repeatCount -= count;
+      } else if (this->literalCount > 0) {
+        if (this->groupCursor == 8 && n >= 8 && this->literalCount >= 8) {
+          int64_t nGroups = std::min(n, static_cast<int64_t>(this->literalCount)) / 8;
+          this->p += std::min(nGroups * this->bitWidth, static_cast<int64_t>(this->end - this->p));
+          n -= nGroups * 8;
+          this->literalCount -= nGroups * 8;
+        } else {
+          if (this->groupCursor == 8) {
+            this->unpackGroup(this->group);
+            this->groupCursor = 0;
+          }
+          this->groupCursor++;
+          n--;
+          this->literalCount--;
+        }
+      } else {
+        this->readRunHeader();
+      }
+    }
+  }
+
+private:
+  void readRunHeader() {
+    uint64_t header = readUleb128(&this->p, this->end);
+    if (header & 1) {
+      this->literalCount = static_cast<uint32_t>((header >> 1) * 8);
+      this->groupCursor = 8;
+    } else {
+      this->repeatCount = static_cast<uint32_t>(header >> 1);
+      const int nBytes = (this->bitWidth + 7) / 8;
+      if (this->end - this->p < nBytes) throwCorruptPage("truncated RLE run");
+      uint32_t value = 0;
+      std::memcpy(&value, this->p, nBytes); // little-endian
+      this->repeatValue = value;
+      this->p += nBytes;
+    }
+    if (this->repeatCount == 0 && this->literalCount == 0) throwCorruptPage("empty RLE run");
+  }
+
+  void unpackGroup(uint32_t* out) {
+    if (this->p >= this->end && this->bitWidth > 0) throwCorruptPage("truncated bit-packed run");
+    unpack8(this->p, this->end - this->p, this->bitWidth, out);
+    this->p += std::min(static_cast<ptrdiff_t>(this->bitWidth), this->end - this->p);
+  }
+};
+
+
+/**
+ * Decoder for PLAIN-encoded fixed-width values.
+ */
+template<typename T>
+class PlainDecoder {
+  const uint8_t* p;
+  const uint8_t* end;
+
+public:
+  PlainDecoder() : p(nullptr), end(nullptr) {}
+
+  void reset(const uint8_t* data, size_t size) {
+    this->p = data;
+    this->end = data + size;
+  }
+
+  T next() {
+    if (this->end - this->p < static_cast<ptrdiff_t>(sizeof(T))) throwCorruptPage("truncated PLAIN value");
+    T value;
+    std::memcpy(&value, this->p, sizeof(T)); // may be unaligned
+    this->p += sizeof(T);
+    return value;
+  }
+
+  void skip(int64_t n) {
+    if ((this->end - this->p) / static_cast<ptrdiff_t>(sizeof(T)) < n) throwCorruptPage("truncated PLAIN value");
+    this->p += n * sizeof(T);
+  }
+};
+
+
+/**
+ * Decoder for PLAIN-encoded BYTE_ARRAY values.
+ *
+ * Returned ByteArrays point into the page buffer.
+ */
+template<>
+class PlainDecoder<parquet::ByteArray> {
+  const uint8_t* p;
+  const uint8_t* end;
+
+public:
+  PlainDecoder() : p(nullptr), end(nullptr) {}
+
+  void reset(const uint8_t* data, size_t size) {
+    this->p = data;
+    this->end = data + size;
+  }
+
+  parquet::ByteArray next() {
+    if (this->end - this->p < 4) throwCorruptPage("truncated BYTE_ARRAY length");
+    uint32_t len;
+    std::memcpy(&len, this->p, 4);
+    if (static_cast<uint64_t>(this->end - this->p - 4) < len) throwCorruptPage("truncated BYTE_ARRAY value");
+    parquet::ByteArray value(len, this->p + 4);
+    this->p += 4 + len;
+    return value;
+  }
+
+  void skip(int64_t n) {
+    while (n--) {
+      this->next();
+    }
+  }
+
+  /** Where the next value's length prefix starts. */
+  const uint8_t* position() const { return this->p; }
+
+  /** Where the page's values end. */
+  const uint8_t* limit() const { return this->end; }
+};
+
+
+/**
+ * Decoder for DELTA_BINARY_PACKED INT32 and INT64 values.
+ *
+ * We unpack one miniblock (usually 32 values) at a time.
+ */
+template<typename T>
+class DeltaBinaryPackedDecoder {
+  typedef typename std::make_unsigned<T>::type UInt;
+
+  const uint8_t* p;
+  const uint8_t* end;
+  uint64_t valuesPerBlock;
+  uint64_t miniblocksPerBlock;
+  uint64_t valuesPerMiniblock;
+  uint64_t valuesLeft; // total, including miniblock
+  bool firstValuePending;
+  UInt lastValue;
+  UInt minDelta; // of the current block
+  std::vector<uint8_t> bitWidths; // of the current block's miniblocks
+  uint64_t miniblockIndex; // within current block; == miniblocksPerBlock means "read next block header"
+  std::vector<UInt> miniblock; // unpacked deltas, minus minDelta
+  uint64_t miniblockCursor; // [0, valuesPerMiniblock]
+
+public:
+  DeltaBinaryPackedDecoder()
+    : p(nullptr), end(nullptr), valuesPerBlock(0), miniblocksPerBlock(0), valuesPerMiniblock(0)
+    , valuesLeft(0), firstValuePending(false), lastValue(0), minDelta(0), miniblockIndex(0), miniblockCursor(0)
+  {
+  }
+
+  void reset(const uint8_t* data, size_t size) {
+    this->p = data;
+    this->end = data + size;
+    this->valuesPerBlock = readUleb128(&this->p, this->end);
+    this->miniblocksPerBlock = readUleb128(&this->p, this->end);
+    this->valuesLeft = readUleb128(&this->p, this->end);
+    this->lastValue = static_cast<UInt>(readZigZagVarint(&this->p, this->end));
+    if (
+      this->miniblocksPerBlock == 0
+      || this->valuesPerBlock % this->miniblocksPerBlock != 0
+      || (this->valuesPerBlock / this->miniblocksPerBlock) % 8 != 0
+      || this->valuesPerBlock > 65536
+    ) {
+      throwCorruptPage("invalid DELTA_BINARY_PACKED header");
+    }
+    this->valuesPerMiniblock = this->valuesPerBlock / this->miniblocksPerBlock;
+    this->bitWidths.resize(this->miniblocksPerBlock);
+    this->miniblock.resize(this->valuesPerMiniblock);
+    this->miniblockIndex = this->miniblocksPerBlock;
+    this->miniblockCursor = this->valuesPerMiniblock;
+    this->firstValuePending = true;
+  }
+
+  T next() {
+    if (this->valuesLeft == 0) throwCorruptPage("too few DELTA_BINARY_PACKED values");
+    this->valuesLeft--;
+    if (this->firstValuePending) {
+      this->firstValuePending = false;
+    } else {
+      if (this->miniblockCursor == this->valuesPerMiniblock) {
+        this->loadMiniblock();
+      }
+      // Unsigned arithmetic wraps, as the spec requires
+      this->lastValue += this->minDelta + this->miniblock[this->miniblockCursor++];
+    }
+    return static_cast<T>(this->lastValue);
+  }
+
+  void skip(int64_t n) {
+    while (n--) {
+      this->next();
+    }
+  }
+
+private:
+  void loadMiniblock() {
+    if (this->miniblockIndex == this->miniblocksPerBlock) {
+      this->minDelta = static_cast<UInt>(readZigZagVarint(&this->p, this->end));
+      if (static_cast<uint64_t>(this->end - this->p) < this->miniblocksPerBlock) throwCorruptPage("truncated DELTA_BINARY_PACKED block");
+      std::copy(this->p, this->p + this->miniblocksPerBlock, this->bitWidths.begin());
+      this->p += this->miniblocksPerBlock;
+      this->miniblockIndex = 0;
+    }
+
+    const int bitWidth = this->bitWidths[this->miniblockIndex];
+    if (bitWidth > static_cast<int>(sizeof(UInt) * 8)) throwCorruptPage("invalid DELTA_BINARY_PACKED bit width");
+    for (uint64_t i = 0; i < this->valuesPerMiniblock; i += 8) {
+      // The final miniblock may be truncated; unpack8() reads missing bits as 0
+      if (this->p >= this->end && bitWidth > 0) throwCorruptPage("truncated DELTA_BINARY_PACKED miniblock");
+      unpack8(this->p, this->end - this->p, bitWidth, &this->miniblock[i]);
+      this->p += std::min(static_cast<ptrdiff_t>(bitWidth), this->end - this->p);
+    }
+    this->miniblockIndex++;
+    this->miniblockCursor = 0;
+  }
+};
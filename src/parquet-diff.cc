@@ -1,302 +1,62 @@
-#include <exception>
 #include <iostream>
-#include <memory>
+#include <stdexcept>
 #include <string>
 
-#include <double-conversion/double-conversion.h> // already a dep of arrow; and printf won't do
-#include <parquet/api/reader.h>
-#include <parquet/api/schema.h>
-#include <parquet/exception.h>
+#include <gflags/gflags.h>
 
 #include "common.h"
+#include "diff.h"
+#include "reader-flags.h"
 
+DECLARE_int64(buffer_size); // reader-flags.cc
 
-std::unique_ptr<parquet::ParquetFileReader> openParquetFile(const std::string& path) {
-  try {
-    return parquet::ParquetFileReader::OpenFile(path); // raises?
-  } catch (const parquet::ParquetException& ex) {
-    std::cerr << ex.what() << std::endl;
-    std::_Exit(1);
-  }
-}
-
+DEFINE_int32(threads, 0, "number of column chunks to compare at once (0 means one per CPU)");
+DEFINE_int64(max_differences, 1, "write at most this many differing cells");
+DEFINE_bool(summary, false, "compare every cell, and write how many differ in each column and row group");
+DEFINE_string(key, "", "comma-separated columns that identify a row: match rows by these, in any order");
+DEFINE_int64(key_memory, 256 * 1024 * 1024, "with --key, maximum bytes of rows to hold in RAM; more spill to temporary files (-1 for no limit)");
+DEFINE_bool(loose_row_groups, false, "compare each column's rows across row-group boundaries, so files with different row-group sizes may be equal");
+DEFINE_string(columns, "", "comma-separated columns to compare (default all)");
+DEFINE_string(row_range, "", "[start, end) range of rows to compare (default all)");
+DEFINE_bool(arrow, false, "file 2 is an Arrow IPC file (such as parquet-to-arrow writes): compare its columns' values with file 1's");
 
-int diffColumn(int columnNumber, const parquet::ColumnDescriptor& column1, const parquet::ColumnDescriptor& column2) {
-  if (column1.name() != column2.name()) {
-    std::cout
-      << "Column " << columnNumber << " name:" << std::endl
-      << "-" << column1.name() << std::endl
-      << "+" << column2.name() << std::endl;
-    return 1;
-  }
 
-  if (column1.physical_type() != column2.physical_type()) {
-    std::cout
-      << "Column " << columnNumber << " (" << column1.name() << ") physical type:" << std::endl
-      << "-" << TypeToString(column1.physical_type()) << std::endl
-      << "+" << TypeToString(column2.physical_type()) << std::endl;
-    return 1;
-  }
-
-  if (!column1.logical_type()->Equals(*(column2.logical_type()))) {
-    std::cout
-      << "Column " << columnNumber << " (" << column1.name() << ") logical type:" << std::endl
-      << "-" << column1.logical_type()->ToString() << std::endl
-      << "+" << column2.logical_type()->ToString() << std::endl;
-    return 1;
-  }
-
-  // To keep concepts simple, let's ignore repetition/definition levels.
-  // (We welcome patches that would support def/rep levels....)
-  if (column1.max_definition_level() > 1) {
-    std::cout
-      << "Column " << columnNumber << " (" << column1.name() << ") uses unsupported max_definition_level " << column1.max_definition_level() << std::endl;
+int main(int argc, char** argv) {
+  std::string usage = std::string("Usage: ") + argv[0] + " PARQUET_FILENAME_1 PARQUET_FILENAME_2";
+  gflags::SetUsageMessage(usage);
+  // gflags exits 1 when a validator fails, and 1 means the files differ
+  gflags::RegisterFlagValidator(&FLAGS_buffer_size, nullptr);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 3) {
+    gflags::ShowUsageWithFlags(argv[0]);
     return 2;
   }
-
-  if (column1.max_repetition_level() > 0) {
-    std::cout
-      << "Column " << columnNumber << " (" << column1.name() << ") uses unsupported max_repetition_level " << column1.max_repetition_level() << std::endl;
+  if (FLAGS_buffer_size <= 0) {
+    std::cerr << "--buffer-size must be positive" << std::endl;
     return 2;
   }
 
-  return 0;
-}
-
-
-int diffSchema(const parquet::SchemaDescriptor& schema1, const parquet::SchemaDescriptor& schema2) {
-  const int nColumns = schema1.num_columns();
-  if (schema2.num_columns() != nColumns) {
-    std::cout << "Number of columns:" << std::endl << "-" << nColumns << std::endl << "+" << schema2.num_columns() << std::endl;
-    return 1;
-  }
-
-  for (int i = 0; i < nColumns; i++) {
-    if (diffColumn(i, *(schema1.Column(i)), *(schema2.Column(i)))) {
-      return 1;
-    }
-  }
-
-  return 0;
-}
-
-
-template <typename DType>
-void readColumnChunk(int rowGroupNumber, int columnNumber, parquet::TypedColumnReader<DType>& chunk, int nRows, typename DType::c_type* values, int16_t* valid) {
-  int64_t valueOffset = 0;
-  for (int64_t validOffset = 0; validOffset < nRows;) {
-    int64_t nValuesReadThisBatch;
-    int64_t nReadThisBatch = chunk.ReadBatch(
-      nRows - validOffset, // batch_size
-      &valid[validOffset],
-      nullptr, // rep_levels
-      &values[valueOffset],
-      &nValuesReadThisBatch
-    );
-    if (nReadThisBatch == 0) {
-      break;
-    }
-
-    validOffset += nReadThisBatch;
-    valueOffset += nValuesReadThisBatch;
-  }
-}
-
-
-template <typename CType>
-std::string valueToString(const CType& v);
-
-
-template<>
-std::string valueToString(const int32_t& i32) {
-  return std::to_string(i32);
-}
-
-
-template<>
-std::string valueToString(const int64_t& i64) {
-  return std::to_string(i64);
-}
-
-
-template<>
-std::string valueToString(const parquet::ByteArray& byteArray) {
-	return parquet::ByteArrayToString(byteArray);
-}
-
-
-template<>
-std::string valueToString(const float& value) {
-  static const int kBufferSize = 128; // the number in https://github.com/google/double-conversion/blob/master/test/cctest/test-conversions.cc
-  char buf[kBufferSize];
-  std::fill(&buf[0], &buf[kBufferSize], 0); // initialize
-  double_conversion::StringBuilder builder(buf, kBufferSize);
-  const double_conversion::DoubleToStringConverter& converter(double_conversion::DoubleToStringConverter::EcmaScriptConverter());
-  if (converter.ToShortestSingle(value, &builder)) {
-    // No need to call this->doubleBuilder.Finalize() because we know
-    // where the string ends.
-    return std::string(&buf[0], builder.position());
-  } else {
-    return "(error converting float)";
-    // I guess we can recover from this. According to the docs, there's no
-    // way for this to ever happen anyway.
-  }
-}
-
-
-template<>
-std::string valueToString(const double& value) {
-  static const int kBufferSize = 128; // the number in https://github.com/google/double-conversion/blob/master/test/cctest/test-conversions.cc
-  char buf[kBufferSize];
-  std::fill(&buf[0], &buf[kBufferSize], 0); // initialize
-  double_conversion::StringBuilder builder(&buf[0], kBufferSize);
-  const double_conversion::DoubleToStringConverter& converter(double_conversion::DoubleToStringConverter::EcmaScriptConverter());
-  if (converter.ToShortest(value, &builder)) {
-    // No need to call this->doubleBuilder.Finalize() because we know
-    // where the string ends.
-    return std::string(&buf[0], builder.position());
-  } else {
-    return "(error converting double)";
-    // I guess we can recover from this. According to the docs, there's no
-    // way for this to ever happen anyway.
-  }
-}
-
-
-template <typename DType>
-int diffColumnChunkTyped(int rowGroupNumber, int columnNumber, parquet::TypedColumnReader<DType>& chunk1, parquet::TypedColumnReader<DType>& chunk2, int nRows) {
-  std::vector<typename DType::c_type> values1(nRows);
-  std::vector<typename DType::c_type> values2(nRows);
-  std::vector<int16_t> valid1(nRows); // 1 = there is a value; 0 = skipped a value
-  std::vector<int16_t> valid2(nRows); // 1 = there is a value; 0 = skipped a value
-
-  readColumnChunk(rowGroupNumber, columnNumber, chunk1, nRows, &values1[0], &valid1[0]);
-  readColumnChunk(rowGroupNumber, columnNumber, chunk2, nRows, &values2[0], &valid2[0]);
-
-  for (int i = 0, valueOffset = 0; i < nRows; i++) {
-    if (valid1[i]) {
-      // left: value
-      if (valid2[i]) {
-        // right: value
-        if (values1[valueOffset] != values2[valueOffset]) {
-          std::cout
-            << "RowGroup " << rowGroupNumber << ", Column " << columnNumber << ", Row " << i << ":" << std::endl
-            << "-" << valueToString(values1[valueOffset]) << std::endl
-            << "+" << valueToString(values2[valueOffset]) << std::endl;
-          return 1;
-        }
-      } else {
-        // right: (null)
-        std::cout
-          << "RowGroup " << rowGroupNumber << ", Column " << columnNumber << ", Row " << i << ":" << std::endl
-          << "-" << valueToString(values1[valueOffset]) << std::endl
-          << "+(null)" << std::endl;
-        return 1;
-      }
-      valueOffset++;
-    } else {
-      // left: (null)
-      if (valid2[i]) {
-        // right: value
-        std::cout
-          << "RowGroup " << rowGroupNumber << ", Column " << columnNumber << ", Row " << i << ":" << std::endl
-          << "-(null)" << std::endl
-          << "+" << valueToString(values2[valueOffset]) << std::endl;
-        return 1;
-      }
-    }
-  }
-
-  return 0;
-}
-
-
-int diffColumnChunk(int rowGroupNumber, int columnNumber, parquet::ColumnReader* chunk1, parquet::ColumnReader* chunk2, int nRows) {
-#define HANDLE_TYPED(type) \
-  { \
-    auto chunk1Typed(dynamic_cast<parquet::TypedColumnReader<type>*>(chunk1)); \
-    auto chunk2Typed(dynamic_cast<parquet::TypedColumnReader<type>*>(chunk2)); \
-    if (chunk1Typed && chunk2Typed) { \
-      return diffColumnChunkTyped<type>(rowGroupNumber, columnNumber, *chunk1Typed, *chunk2Typed, nRows); \
-    } \
-  }
-  HANDLE_TYPED(parquet::Int32Type)
-  HANDLE_TYPED(parquet::Int64Type)
-  HANDLE_TYPED(parquet::FloatType)
-  HANDLE_TYPED(parquet::DoubleType)
-  HANDLE_TYPED(parquet::ByteArrayType)
-#undef HANDLE_TYPED
-  std::cout << "Row group " << rowGroupNumber << ", column " << columnNumber << ": unhandled physical data type";
-  return 1;
-}
-
-
-int diffRowGroup(int rowGroupNumber, parquet::RowGroupReader& group1, parquet::RowGroupReader& group2) {
-  const parquet::RowGroupMetaData* metadata1 = group1.metadata();
-  const parquet::RowGroupMetaData* metadata2 = group2.metadata();
-
-  int nRows = metadata1->num_rows();
-  if (metadata2->num_rows() != nRows) {
-    std::cout
-      << "RowGroup " << rowGroupNumber << " number of rows:" << std::endl
-      << "-" << nRows << std::endl
-      << "+" << metadata2->num_rows() << std::endl;
-    return 1;
-  }
-
-  // assume both groups have same nColumns (since the caller guarantees it)
-  int nColumns = metadata1->num_columns();
-  for (int i = 0; i < nColumns; i++) {
-    if (diffColumnChunk(rowGroupNumber, i, group1.Column(i).get(), group2.Column(i).get(), nRows)) {
-      return 1;
-    }
-  }
-
-  return 0;
-}
-
-
-/**
- * Return 0 iff both files are equivalent or 1 if they differ.
- *
- * If returning 1, write a difference in text form to std::cout.
- */
-int diff(const std::string& path1, const std::string& path2)
-{
-  std::unique_ptr<parquet::ParquetFileReader> reader1(openParquetFile(path1));
-  std::unique_ptr<parquet::ParquetFileReader> reader2(openParquetFile(path2));
-
-  const auto metadata1 = reader1->metadata();
-  const auto metadata2 = reader2->metadata();
-
-  if (diffSchema(*(metadata1->schema()), *(metadata2->schema()))) {
-    return 1;
-  }
-
-  const int nRowGroups = metadata1->num_row_groups();
-  if (metadata2->num_row_groups() != nRowGroups) {
-    std::cout << "Number of row groups:" << std::endl << "-" << nRowGroups << std::endl << "+" << metadata2->num_row_groups() << std::endl;
-    return 1;
-  }
-
-  for (int i = 0; i < nRowGroups; i++) {
-    if (diffRowGroup(i, *(reader1->RowGroup(i)), *(reader2->RowGroup(i)))) {
-      return 1;
-    }
-  }
-
-  return 0;
-}
-
-
-int main(int argc, char** argv) {
-  if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " PARQUET_FILENAME_1 PARQUET_FILENAME_2" << std::endl;
-    return 1;
-  }
-
   const std::string path1(argv[1]);
   const std::string path2(argv[2]);
 
-  return diff(path1, path2);
+  DiffOptions options;
+  options.threads = FLAGS_threads;
+  options.maxDifferences = FLAGS_max_differences;
+  options.summary = FLAGS_summary;
+  options.looseRowGroups = FLAGS_loose_row_groups;
+  options.key = FLAGS_key;
+  options.keyMemory = FLAGS_key_memory;
+  options.columns = FLAGS_columns;
+  options.rowRange = FLAGS_row_range;
+  options.arrow = FLAGS_arrow;
+  options.reader = readerOptionsFromFlags();
+
+  // 1 means the files differ, so every error (an invalid file, a page we
+  // can't decode, an option that doesn't apply) is 2
+  try {
+    return diff(path1, path2, options, std::cout);
+  } catch (const std::exception& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 2;
+  }
 }
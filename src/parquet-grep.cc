@@ -0,0 +1,264 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <arrow/api.h>
+#include <gflags/gflags.h>
+#include <parquet/api/reader.h>
+#include <parquet/exception.h>
+
+#include "common.h"
+#include "reader-flags.h"
+#include "column-iterator.h"
+#include "printer.h"
+#include "substring-search.h"
+
+DEFINE_int64(max_rows, -1, "stop after writing this many matching rows (-1 for no limit)");
+DEFINE_int64(dictionary_memory, 256 * 1024 * 1024, "maximum bytes of dictionaries to hold in RAM; more spill to a temporary file (-1 for no limit)");
+
+
+/**
+ * Prints one column's values, skipping rows that don't match.
+ */
+class Transcriber
+{
+public:
+  virtual ~Transcriber() {}
+
+  /**
+   * Skip nRows values.
+   *
+   * Undefined behavior if there are not that many values to skip.
+   */
+  virtual void skipRows(int64_t nRows) = 0;
+
+  /**
+   * Print the next value.
+   *
+   * Undefined behavior if there is no next element.
+   */
+  virtual void printNext(Printer& printer, size_t outputColumnIndex) = 0;
+
+  /**
+   * Print the header field (CSV-only).
+   */
+  virtual void printHeaderField(Printer& printer, size_t outputColumnIndex) = 0;
+};
+
+
+template<typename FileColumnIteratorType>
+class BufferedTranscriber : public Transcriber
+{
+  std::unique_ptr<FileColumnIteratorType> reader;
+
+public:
+  BufferedTranscriber(std::unique_ptr<FileColumnIteratorType> reader_) : reader(std::move(reader_)) {}
+
+  void skipRows(int64_t nRows) override
+  {
+    this->reader->skipRows(nRows);
+  }
+
+  void printNext(Printer& printer, size_t outputColumnIndex) override
+  {
+    printer.writeFieldStart(outputColumnIndex, this->reader->getName());
+    auto valueOrNull = this->reader->next();
+    if (valueOrNull.has_value()) {
+      printer.write(valueOrNull.value());
+    } else {
+      printer.writeNull();
+    }
+  }
+
+  void printHeaderField(Printer& printer, size_t outputColumnIndex) override
+  {
+    printer.writeHeaderField(outputColumnIndex, this->reader->getName());
+  }
+};
+
+
+static std::unique_ptr<Transcriber>
+makeTranscriberForColumn(parquet::ParquetFileReader& fileReader, int columnIndex, DictionaryBudget& dictionaryBudget)
+{
+  return visitColumnReaderType(
+    fileReader.metadata()->schema()->Column(columnIndex),
+    [&]<typename BufferedReaderType>() -> std::unique_ptr<Transcriber> {
+      typedef FileColumnIterator<BufferedReaderType> FileColumnIteratorType;
+      auto iterator = std::make_unique<FileColumnIteratorType>(fileReader, columnIndex, dictionaryBudget, true);
+      return std::make_unique<BufferedTranscriber<FileColumnIteratorType>>(std::move(iterator));
+    }
+  );
+}
+
+
+/**
+ * List the columns we search: the ones we'd print as strings.
+ */
+static std::vector<int>
+stringColumns(const parquet::SchemaDescriptor& schema)
+{
+  std::vector<int> ret;
+  for (int i = 0; i < schema.num_columns(); i++) {
+    const bool isString = visitColumnReaderType(schema.Column(i), []<typename BufferedReaderType>() {
+      return std::is_same<typename BufferedReaderType::PrintableType, std::string_view>::value;
+    });
+    if (isString) {
+      ret.push_back(i);
+    }
+  }
+  return ret;
+}
+
+
+/**
+ * Set `matches[i]` to 1 where row i of a row group's string column contains
+ * the needle.
+ */
+static void
+markMatchingRows(
+  parquet::RowGroupReader& rowGroupReader,
+  int columnIndex,
+  const SubstringSearcher& searcher,
+  DictionaryBudget& dictionaryBudget,
+  std::vector<uint8_t>& matches
+)
+{
+  typedef PageColumnReader<parquet::ByteArrayReader, std::string_view> PageReaderType;
+
+  const int64_t nRows = matches.size();
+  std::unique_ptr<parquet::ColumnChunkMetaData> chunkMetadata(rowGroupReader.metadata()->ColumnChunk(columnIndex));
+  if (PageReaderType::canDecode(*chunkMetadata)) {
+    PageReaderType reader(rowGroupReader.metadata()->schema()->Column(columnIndex), rowGroupReader.GetColumnPageReader(columnIndex), dictionaryBudget);
+    reader.markMatchingRows(searcher, nRows, &matches[0]);
+  } else {
+    // An encoding we don't decode ourselves (e.g., DELTA_BYTE_ARRAY)
+    std::shared_ptr<parquet::ByteArrayReader> columnReader(
+      std::dynamic_pointer_cast<parquet::ByteArrayReader>(rowGroupReader.Column(columnIndex))
+    );
+    BufferedStringColumnReader reader(columnReader);
+    for (int64_t i = 0; i < nRows; i++) {
+      std::optional<std::string_view> valueOrNull = reader.next();
+      if (valueOrNull.has_value() && searcher.contains(valueOrNull.value())) {
+        matches[i] = 1;
+      }
+    }
+  }
+}
+
+
+/**
+ * Write every row with a string containing `needle`.
+ *
+ * We search one row group at a time: first the string columns, then we print
+ * the rows that matched. Row groups with no matches cost nothing more.
+ */
+static void
+grepParquet(const std::string& path, const std::string& needle, Printer& printer)
+{
+  std::unique_ptr<parquet::ParquetFileReader> fileReader(openParquet(path, readerOptionsFromFlags()));
+  const parquet::FileMetaData& metadata = *fileReader->metadata();
+  const int nColumns = metadata.num_columns();
+  const SubstringSearcher searcher(needle);
+  const std::vector<int> searchColumns(stringColumns(*metadata.schema()));
+
+  DictionaryBudget dictionaryBudget(FLAGS_dictionary_memory);
+  std::vector<std::unique_ptr<Transcriber>> transcribers;
+  if (metadata.num_row_groups() > 0) { // FileColumnIterator needs a row group
+    for (int i = 0; i < nColumns; i++) {
+      transcribers.push_back(makeTranscriberForColumn(*fileReader, i, dictionaryBudget));
+    }
+  }
+
+  printer.writeFileHeader();
+  for (size_t i = 0; i < transcribers.size(); i++) {
+    transcribers[i]->printHeaderField(printer, i);
+  }
+
+  const uint64_t maxRows = FLAGS_max_rows >= 0 ? FLAGS_max_rows : UINT64_MAX;
+  uint64_t nWritten = 0;
+  int64_t transcribersRow = 0; // next row our transcribers will read
+  int64_t rowGroupStart = 0; // file row index of the row group's first row
+  std::vector<uint8_t> matches;
+  for (int rowGroup = 0; rowGroup < metadata.num_row_groups() && nWritten < maxRows; rowGroup++) {
+    std::shared_ptr<parquet::RowGroupReader> rowGroupReader(fileReader->RowGroup(rowGroup));
+    const int64_t nRows = rowGroupReader->metadata()->num_rows();
+    matches.assign(nRows, 0);
+    for (int columnIndex : searchColumns) {
+      markMatchingRows(*rowGroupReader, columnIndex, searcher, dictionaryBudget, matches);
+    }
+
+    for (int64_t i = 0; i < nRows && nWritten < maxRows; i++) {
+      if (!matches[i]) continue;
+
+      const int64_t row = rowGroupStart + i;
+      for (const std::unique_ptr<Transcriber>& transcriber : transcribers) {
+        transcriber->skipRows(row - transcribersRow);
+      }
+      printer.writeRecordStart(nWritten);
+      for (size_t c = 0; c < transcribers.size(); c++) {
+        transcribers[c]->printNext(printer, c);
+      }
+      printer.writeRecordStop();
+      transcribersRow = row + 1;
+      nWritten++;
+
+      if (printer.failed()) {
+        return; // e.g., the reader hung up
+      }
+    }
+    rowGroupStart += nRows;
+  }
+
+  printer.writeFileFooter();
+  printer.flush();
+}
+
+
+int main(int argc, char** argv) {
+  std::string usage = std::string("Usage: ") + argv[0] + " <NEEDLE> <PARQUET_FILENAME> <FORMAT>";
+  gflags::SetUsageMessage(usage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 4) {
+    gflags::ShowUsageWithFlags(argv[0]);
+    return 1;
+  }
+
+  const std::string needle(argv[1]);
+  const std::string parquetPath(argv[2]);
+  const std::string formatString(argv[3]);
+
+  std::unique_ptr<Printer> printer;
+  if (formatString == "csv") {
+    printer = std::make_unique<CsvPrinter>(stdout, Utf8Validation::None, false);
+  } else if (formatString == "json") {
+    printer = std::make_unique<JsonPrinter>(stdout, Utf8Validation::None, false);
+  } else {
+    std::cerr << "<FORMAT> must be either 'csv' or 'json'" << std::endl;
+    gflags::ShowUsageWithFlags(argv[0]);
+    return 1;
+  }
+
+  try {
+    grepParquet(parquetPath, needle, *printer);
+  } catch (const parquet::ParquetException& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
+  } catch (const std::runtime_error& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
+  }
+
+  if (printer->failed()) {
+    std::cerr << "Failed to write output: " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+  return 0;
+}
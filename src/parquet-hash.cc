@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <parquet/api/reader.h>
+#include <parquet/api/schema.h>
+#include <parquet/exception.h>
+
+#include "column-stream.h"
+#include "common.h"
+#include "hyperloglog.h"
+#include "reader-flags.h"
+
+DEFINE_int32(threads, 0, "number of columns to hash at once (0 means one per CPU)");
+
+
+/**
+ * Change this whenever hashes change, so nobody compares old ones to new.
+ */
+static const char kHashVersion[] = "parquet-hash 2";
+
+
+/**
+ * Hash bytes in this many bytes at a time.
+ */
+static const size_t kHashBufferSize = 64 * 1024;
+
+
+/**
+ * Computes a 128-bit hash of a byte stream: the same on every machine and in
+ * every build, so callers may store it and compare it later.
+ *
+ * Two independent 64-bit lanes mix in eight bytes at a time with mixHash().
+ * It isn't cryptographic: it catches accidents, not forgeries.
+ *
+ * Assumes a little-endian CPU.
+ */
+class StableHasher {
+  uint64_t lo;
+  uint64_t hi;
+  uint64_t nBytes;
+  std::string buffer; // bytes not yet hashed (fewer than 8, between updates)
+
+  void mixWord(uint64_t word) {
+    this->lo = mixHash(this->lo ^ word);
+    this->hi = mixHash(this->hi + (word ^ 0x9e3779b97f4a7c15ull)) ^ (this->hi >> 17);
+  }
+
+public:
+  StableHasher() : lo(0x243f6a8885a308d3ull), hi(0x13198a2e03707344ull), nBytes(0) {}
+
+  void update(const void* data, size_t size) {
+    this->buffer.append(static_cast<const char*>(data), size);
+    this->nBytes += size;
+    if (this->buffer.size() >= kHashBufferSize) {
+      this->flush();
+    }
+  }
+
+  void update(std::string_view bytes) {
+    this->update(bytes.data(), bytes.size());
+  }
+
+  /**
+   * Hash every whole eight-byte word we hold.
+   */
+  void flush() {
+    const size_t nWholeBytes = this->buffer.size() & ~static_cast<size_t>(7);
+    for (size_t i = 0; i < nWholeBytes; i += 8) {
+      uint64_t word;
+      std::memcpy(&word, this->buffer.data() + i, 8);
+      this->mixWord(word);
+    }
+    this->buffer.erase(0, nWholeBytes);
+  }
+
+  /**
+   * Return the hash as 16 bytes. Call once, after the last update().
+   */
+  std::string digest() {
+    this->flush();
+    uint64_t word = 0;
+    std::memcpy(&word, this->buffer.data(), this->buffer.size()); // fewer than 8 bytes
+    this->mixWord(word);
+    this->mixWord(this->nBytes);
+
+    std::string ret(16, '\0');
+    std::memcpy(&ret[0], &this->lo, 8);
+    std::memcpy(&ret[8], &this->hi, 8);
+    return ret;
+  }
+};
+
+
+static std::string
+toHex(const std::string& bytes)
+{
+  static const char kDigits[] = "0123456789abcdef";
+  std::string ret;
+  for (unsigned char c : bytes) {
+    ret.push_back(kDigits[c >> 4]);
+    ret.push_back(kDigits[c & 0xf]);
+  }
+  return ret;
+}
+
+
+/**
+ * Return a column's 16-byte hash: of everything parquet-diff compares in its
+ * schema (name, path, physical and logical types, and maximum definition
+ * and repetition levels -- so required and optional columns differ), and
+ * of every cell.
+ *
+ * A nested column's cells are its items' levels and values, as
+ * LevelEncoder writes them.
+ *
+ * Encodings, compression, Parquet versions and row-group boundaries don't
+ * change the hash.
+ */
+static std::string
+hashColumn(parquet::ParquetFileReader& fileReader, int columnIndex)
+{
+  const parquet::ColumnDescriptor& column = *fileReader.metadata()->schema()->Column(columnIndex);
+  const int16_t levels[2] = { column.max_definition_level(), column.max_repetition_level() };
+
+  StableHasher hasher;
+  const std::string header(
+    column.name() + '\0'
+    + column.path()->ToDotString() + '\0'
+    + parquet::TypeToString(column.physical_type()) + '\0'
+    + column.logical_type()->ToString() + '\0'
+    + std::string(reinterpret_cast<const char*>(levels), sizeof(levels))
+  );
+  hasher.update(header);
+
+  std::string cells;
+  if (levels[0] > 1 || levels[1] > 0) {
+    std::unique_ptr<LevelEncoder> encoder(makeLevelEncoder(fileReader, columnIndex));
+    while (encoder->appendNextBatch(cells)) {
+      if (cells.size() >= kHashBufferSize) {
+        hasher.update(cells);
+        cells.clear();
+      }
+    }
+    hasher.update(cells);
+    return hasher.digest();
+  }
+
+  std::unique_ptr<CellEncoder> encoder(makeCellEncoder(fileReader, columnIndex));
+  const int64_t nRows = fileReader.metadata()->num_rows();
+  for (int64_t row = 0; row < nRows; row++) {
+    encoder->appendNext(cells);
+    if (cells.size() >= kHashBufferSize) {
+      hasher.update(cells);
+      cells.clear();
+    }
+  }
+  hasher.update(cells);
+  return hasher.digest();
+}
+
+
+int main(int argc, char** argv) {
+  std::string usage = std::string("Usage: ") + argv[0] + " <PARQUET_FILENAME>";
+  gflags::SetUsageMessage(usage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 2) {
+    gflags::ShowUsageWithFlags(argv[0]);
+    return 1;
+  }
+  const std::string parquetPath(argv[1]);
+
+  std::unique_ptr<parquet::ParquetFileReader> fileReader;
+  try {
+    fileReader = openParquet(parquetPath, readerOptionsFromFlags());
+  } catch (const parquet::ParquetException& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
+  }
+  const parquet::FileMetaData& metadata = *fileReader->metadata();
+  const int nColumns = metadata.num_columns();
+  const int64_t nRows = metadata.num_rows();
+
+  // Each thread opens the file itself, and takes one column at a time
+  std::vector<std::string> columnHashes(nColumns);
+  std::atomic<int> nextColumn(0);
+  auto work = [&]() {
+    try {
+      std::unique_ptr<parquet::ParquetFileReader> threadFileReader(openParquet(parquetPath, readerOptionsFromFlags()));
+      for (int i = nextColumn++; i < nColumns; i = nextColumn++) {
+        columnHashes[i] = hashColumn(*threadFileReader, i);
+      }
+    } catch (const std::exception& ex) {
+      std::cerr << "Failed to read Parquet file: " << ex.what() << std::endl;
+      std::_Exit(1);
+    }
+  };
+
+  int nThreads = FLAGS_threads > 0 ? FLAGS_threads : std::max(1u, std::thread::hardware_concurrency());
+  nThreads = std::min(nThreads, std::max(nColumns, 1));
+  std::vector<std::thread> threads;
+  for (int i = 1; i < nThreads; i++) {
+    threads.emplace_back(work);
+  }
+  work(); // on this thread, too
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // The file's hash covers its row count and its columns' hashes, in order
+  StableHasher fileHasher;
+  fileHasher.update(kHashVersion, sizeof(kHashVersion));
+  fileHasher.update(&nRows, sizeof(nRows));
+  fileHasher.update(&nColumns, sizeof(nColumns));
+  for (const std::string& columnHash : columnHashes) {
+    fileHasher.update(columnHash);
+  }
+
+  std::cout << toHex(fileHasher.digest()) << std::endl;
+  for (int i = 0; i < nColumns; i++) {
+    std::cout << toHex(columnHashes[i]) << " " << metadata.schema()->Column(i)->path()->ToDotString() << std::endl;
+  }
+  return 0;
+}
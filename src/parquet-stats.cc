@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <gflags/gflags.h>
+#include <parquet/api/reader.h>
+#include <parquet/exception.h>
+
+#include "common.h"
+#include "reader-flags.h"
+#include "column-iterator.h"
+#include "hyperloglog.h"
+#include "printer.h"
+
+DEFINE_int32(threads, 0, "number of columns to profile at once (0 means one per CPU)");
+DEFINE_int32(top_values, 10, "number of most-common values to report per column");
+
+
+/**
+ * How we store a PrintableType in a ColumnProfile.
+ *
+ * We can't keep std::string_views: they point into pages that die.
+ */
+template<typename PrintableType>
+struct ProfileTraits {
+  typedef PrintableType Stored;
+  static constexpr bool kIsNumber = true;
+  static Stored store(PrintableType value) { return value; }
+  static PrintableType load(const Stored& value) { return value; }
+  static uint64_t hash(PrintableType value) {
+    if constexpr (std::is_floating_point<PrintableType>::value) {
+      double d = value == 0 ? 0.0 : value; // -0.0 == 0.0
+      uint64_t bits;
+      std::memcpy(&bits, &d, sizeof(bits));
+      return mixHash(bits);
+    } else {
+      return mixHash(static_cast<uint64_t>(value));
+    }
+  }
+};
+
+template<>
+struct ProfileTraits<std::string_view> {
+  typedef std::string Stored;
+  static constexpr bool kIsNumber = false;
+  static Stored store(std::string_view value) { return Stored(value); }
+  static std::string_view load(const Stored& value) { return value; }
+  static uint64_t hash(std::string_view value) { return mixHash(std::hash<std::string_view>()(value)); }
+};
+
+template<typename Wrapper, typename Int>
+struct WrapperProfileTraits {
+  typedef Int Stored;
+  static constexpr bool kIsNumber = false;
+  static Stored store(Wrapper value) { return value.value; }
+  static Wrapper load(const Stored& value) { return Wrapper { value }; }
+  static uint64_t hash(Wrapper value) { return mixHash(static_cast<uint64_t>(value.value)); }
+};
+
+template<> struct ProfileTraits<Date> : public WrapperProfileTraits<Date, int32_t> {};
+template<> struct ProfileTraits<TimestampMillis> : public WrapperProfileTraits<TimestampMillis, int64_t> {};
+template<> struct ProfileTraits<TimestampMicros> : public WrapperProfileTraits<TimestampMicros, int64_t> {};
+template<> struct ProfileTraits<TimestampNanos> : public WrapperProfileTraits<TimestampNanos, int64_t> {};
+
+
+/**
+ * Statistics about one column, computed in a single pass.
+ */
+template<typename PrintableType>
+class ColumnProfile {
+  typedef ProfileTraits<PrintableType> Traits;
+  typedef typename Traits::Stored Stored;
+
+  /*
+   * Misra-Gries "frequent items" counters: exact while a column has at most
+   * kNCounters distinct values; beyond that, counts are lower bounds, off by
+   * at most nValues / kNCounters.
+   *
+   * "Decrement every counter" is O(1): we add one to counterOffset instead,
+   * and store each counter as its count plus counterOffset. counterBuckets
+   * finds the counters that just reached zero. A value's bucket key is at
+   * most its stored count, so a value we've counted since we bucketed it
+   * moves to a later bucket when we reach it -- paid for by those counts.
+   */
+  static constexpr size_t kNCounters = 1024;
+
+  int64_t nValues; // excluding nulls
+  int64_t nNulls; // including NaN and +/-inf: parquet-to-text-stream writes them as null
+  Stored min;
+  Stored max;
+  double sum; // numbers
+  int64_t sumLengths; // strings
+  std::array<int64_t, 33> lengthHistogram; // strings: [0], [1], [2-3], [4-7], ...
+  HyperLogLog distinct;
+  std::unordered_map<Stored, int64_t> counters; // count + counterOffset
+  std::unordered_map<int64_t, std::vector<const Stored*>> counterBuckets; // keys of `counters`
+  int64_t counterOffset;
+
+public:
+  ColumnProfile()
+    : nValues(0)
+    , nNulls(0)
+    , min()
+    , max()
+    , sum(0)
+    , sumLengths(0)
+    , lengthHistogram{}
+    , counterOffset(0)
+  {
+  }
+
+  void add(const std::optional<PrintableType>& valueOrNull) {
+    if (!valueOrNull.has_value()) {
+      this->nNulls++;
+      return;
+    }
+
+    const PrintableType value = valueOrNull.value();
+    if constexpr (std::is_floating_point<PrintableType>::value) {
+      if (!std::isfinite(value)) {
+        this->nNulls++;
+        return;
+      }
+    }
+
+    if constexpr (std::is_same<PrintableType, std::string_view>::value) {
+      this->sumLengths += value.size();
+      this->lengthHistogram[std::bit_width(value.size())]++;
+      if (this->nValues == 0 || value < this->min) this->min = value;
+      if (this->nValues == 0 || value > this->max) this->max = value;
+    } else {
+      const Stored stored = Traits::store(value);
+      if (this->nValues == 0 || stored < this->min) this->min = stored;
+      if (this->nValues == 0 || stored > this->max) this->max = stored;
+      if constexpr (Traits::kIsNumber) {
+        this->sum += value;
+      }
+    }
+    this->nValues++;
+
+    this->distinct.add(Traits::hash(value));
+    this->countValue(value);
+  }
+
+  /**
+   * Write the statistics as JSON fields, starting with field `fieldIndex`.
+   */
+  void write(JsonPrinter& printer, int fieldIndex, int nTopValues) const {
+    printer.writeFieldStart(fieldIndex++, "null_count");
+    printer.write(this->nNulls);
+    printer.writeFieldStart(fieldIndex++, "distinct_estimate");
+    printer.write(static_cast<int64_t>(std::min(this->distinct.estimate(), static_cast<uint64_t>(this->nValues))));
+
+    printer.writeFieldStart(fieldIndex++, "min");
+    this->writeStored(printer, this->min);
+    printer.writeFieldStart(fieldIndex++, "max");
+    this->writeStored(printer, this->max);
+
+    if constexpr (Traits::kIsNumber) {
+      printer.writeFieldStart(fieldIndex++, "mean");
+      if (this->nValues > 0) {
+        printer.write(this->sum / this->nValues);
+      } else {
+        printer.writeNull();
+      }
+    }
+
+    if constexpr (std::is_same<PrintableType, std::string_view>::value) {
+      printer.writeFieldStart(fieldIndex++, "mean_length");
+      if (this->nValues > 0) {
+        printer.write(static_cast<double>(this->sumLengths) / this->nValues);
+      } else {
+        printer.writeNull();
+      }
+
+      printer.writeFieldStart(fieldIndex++, "length_histogram");
+      printer.writeFileHeader(); // '['
+      int nBuckets = 0;
+      for (size_t bucket = 0; bucket < this->lengthHistogram.size(); bucket++) {
+        if (this->lengthHistogram[bucket] == 0) continue;
+        printer.writeRecordStart(nBuckets++);
+        printer.writeFieldStart(0, "min_length");
+        printer.write(static_cast<int64_t>(bucket == 0 ? 0 : (1ull << (bucket - 1))));
+        printer.writeFieldStart(1, "max_length");
+        printer.write(static_cast<int64_t>(bucket == 0 ? 0 : (1ull << bucket) - 1));
+        printer.writeFieldStart(2, "count");
+        printer.write(this->lengthHistogram[bucket]);
+        printer.writeRecordStop();
+      }
+      printer.writeFileFooter(); // ']'
+    }
+
+    printer.writeFieldStart(fieldIndex++, "top_values");
+    std::vector<std::pair<Stored, int64_t>> top;
+    for (const auto& [value, count] : this->counters) {
+      top.emplace_back(value, count - this->counterOffset);
+    }
+    std::sort(top.begin(), top.end(), [](const auto& a, const auto& b) {
+      return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    if (top.size() > static_cast<size_t>(nTopValues)) {
+      top.resize(nTopValues);
+    }
+    printer.writeFileHeader(); // '['
+    for (size_t i = 0; i < top.size(); i++) {
+      printer.writeRecordStart(i);
+      printer.writeFieldStart(0, "value");
+      this->writeStored(printer, top[i].first);
+      printer.writeFieldStart(1, "count");
+      printer.write(top[i].second);
+      printer.writeRecordStop();
+    }
+    printer.writeFileFooter(); // ']'
+  }
+
+private:
+  void countValue(PrintableType value) {
+    const Stored stored = Traits::store(value);
+    auto it = this->counters.find(stored);
+    if (it != this->counters.end()) {
+      it->second++;
+    } else if (this->counters.size() < kNCounters) {
+      const int64_t count = this->counterOffset + 1;
+      it = this->counters.emplace(stored, count).first;
+      this->counterBuckets[count].push_back(&it->first);
+    } else {
+      // Full: decrement every counter, and forget the ones at zero
+      this->counterOffset++;
+      auto bucket = this->counterBuckets.find(this->counterOffset);
+      if (bucket == this->counterBuckets.end()) return;
+      const std::vector<const Stored*> keys(std::move(bucket->second));
+      this->counterBuckets.erase(bucket);
+      for (const Stored* key : keys) {
+        auto counter = this->counters.find(*key);
+        if (counter->second == this->counterOffset) {
+          this->counters.erase(counter);
+        } else {
+          this->counterBuckets[counter->second].push_back(key);
+        }
+      }
+    }
+  }
+
+  void writeStored(JsonPrinter& printer, const Stored& value) const {
+    if (this->nValues == 0) {
+      printer.writeNull();
+    } else {
+      printer.write(Traits::load(value));
+    }
+  }
+};
+
+
+template<typename PrintableType> static const char* typeName();
+template<> const char* typeName<int32_t>() { return "int32"; }
+template<> const char* typeName<int64_t>() { return "int64"; }
+template<> const char* typeName<uint32_t>() { return "uint32"; }
+template<> const char* typeName<uint64_t>() { return "uint64"; }
+template<> const char* typeName<float>() { return "float32"; }
+template<> const char* typeName<double>() { return "float64"; }
+template<> const char* typeName<std::string_view>() { return "string"; }
+template<> const char* typeName<Date>() { return "date32"; }
+template<> const char* typeName<TimestampMillis>() { return "timestamp[ms]"; }
+template<> const char* typeName<TimestampMicros>() { return "timestamp[us]"; }
+template<> const char* typeName<TimestampNanos>() { return "timestamp[ns]"; }
+
+
+/**
+ * Read one column from start to finish, and return its statistics as a JSON
+ * object.
+ */
+static std::string
+profileColumn(parquet::ParquetFileReader& fileReader, int columnIndex)
+{
+  char* json = nullptr;
+  size_t jsonSize = 0;
+  FILE* fp = open_memstream(&json, &jsonSize);
+  if (!fp) {
+    std::cerr << "Failed to allocate output buffer: " << std::strerror(errno) << std::endl;
+    std::_Exit(1);
+  }
+
+  {
+    // Replace invalid UTF-8, so the output is always valid JSON
+    JsonPrinter printer(fp, Utf8Validation::Replace, false);
+    DictionaryBudget dictionaryBudget(-1); // we hold one column's dictionary at a time
+    const int64_t nRows = fileReader.metadata()->num_rows();
+
+    visitColumnReaderType(
+      fileReader.metadata()->schema()->Column(columnIndex),
+      [&]<typename BufferedReaderType>() {
+        typedef typename BufferedReaderType::PrintableType PrintableType;
+
+        FileColumnIterator<BufferedReaderType> iterator(fileReader, columnIndex, dictionaryBudget, true);
+        ColumnProfile<PrintableType> profile;
+        if (nRows > 0) { // FileColumnIterator needs a row group
+          for (int64_t i = 0; i < nRows; i++) {
+            profile.add(iterator.next());
+          }
+        }
+
+        printer.writeRecordStart(0);
+        printer.writeFieldStart(0, "name");
+        printer.writeString(iterator.getName());
+        printer.writeFieldStart(1, "type");
+        printer.writeString(typeName<PrintableType>());
+        profile.write(printer, 2, FLAGS_top_values);
+        printer.writeRecordStop();
+        return 0;
+      }
+    );
+  }
+
+  fclose(fp);
+  std::string ret(json, jsonSize);
+  free(json);
+  return ret;
+}
+
+
+int main(int argc, char** argv) {
+  std::string usage = std::string("Usage: ") + argv[0] + " <PARQUET_FILENAME>";
+  gflags::SetUsageMessage(usage);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 2) {
+    gflags::ShowUsageWithFlags(argv[0]);
+    return 1;
+  }
+  const std::string parquetPath(argv[1]);
+
+  std::unique_ptr<parquet::ParquetFileReader> fileReader;
+  try {
+    fileReader = openParquet(parquetPath, readerOptionsFromFlags());
+  } catch (const parquet::ParquetException& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
+  }
+  const int nColumns = fileReader->metadata()->num_columns();
+  const int64_t nRows = fileReader->metadata()->num_rows();
+
+  // Each thread opens the file itself, and takes one column at a time
+  std::vector<std::string> columnJsons(nColumns);
+  std::atomic<int> nextColumn(0);
+  auto work = [&]() {
+    try {
+      std::unique_ptr<parquet::ParquetFileReader> threadFileReader(openParquet(parquetPath, readerOptionsFromFlags()));
+      for (int i = nextColumn++; i < nColumns; i = nextColumn++) {
+        columnJsons[i] = profileColumn(*threadFileReader, i);
+      }
+    } catch (const std::exception& ex) {
+      std::cerr << "Failed to read Parquet file: " << ex.what() << std::endl;
+      std::_Exit(1);
+    }
+  };
+
+  int nThreads = FLAGS_threads > 0 ? FLAGS_threads : std::max(1u, std::thread::hardware_concurrency());
+  nThreads = std::min(nThreads, std::max(nColumns, 1));
+  std::vector<std::thread> threads;
+  for (int i = 1; i < nThreads; i++) {
+    threads.emplace_back(work);
+  }
+  work(); // on this thread, too
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  printf("{\"num_rows\":%" PRIi64 ",\"columns\":[", nRows);
+  for (int i = 0; i < nColumns; i++) {
+    if (i > 0) fputc(',', stdout);
+    fwrite(columnJsons[i].data(), 1, columnJsons[i].size(), stdout);
+  }
+  printf("]}");
+
+  return 0;
+}
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <parquet/exception.h>
+
+#include "parquet-tools.h"
+#include "common.h"
+#include "diff.h"
+#include "text-stream.h"
+#include "to-arrow.h"
+
+
+/**
+ * Return code when `write` asked us to stop: what parquet-to-text-stream
+ * exits with when its output fails.
+ */
+static const int kOutputFailed = 141;
+
+
+/**
+ * Error message when something threw a non-std::exception. No exception may
+ * leave a C function: that would abort the caller's process.
+ */
+static const char kUnknownError[] = "Unknown error";
+
+
+static void
+setError(char* error, size_t errorSize, const char* message)
+{
+  if (error == nullptr || errorSize == 0) return;
+  const size_t size = std::min(std::strlen(message), errorSize - 1);
+  std::memcpy(error, message, size);
+  error[size] = '\0';
+}
+
+
+static ReaderOptions
+readerOptions(const parquet_tools_reader_options& options)
+{
+  if (options.buffer_size <= 0) {
+    throw std::runtime_error("buffer_size must be positive");
+  }
+  return ReaderOptions {
+    .mmap = options.mmap != 0,
+    .bufferedStream = options.buffered_stream != 0,
+    .bufferSize = options.buffer_size,
+  };
+}
+
+
+static std::string
+optionalString(const char* value)
+{
+  return value == nullptr ? std::string() : std::string(value);
+}
+
+
+/**
+ * Parse a RangeSet option, like parquet-to-text-stream's flag validator.
+ */
+static RangeSet
+parseRangeSetOption(const char* name, const char* value)
+{
+  const std::string s(optionalString(value));
+  if (s.empty()) {
+    return RangeSet();
+  }
+  auto [rangeSet, ec] = parse_range_set(&*s.cbegin(), &*s.cend());
+  if (ec != std::errc()) {
+    throw std::runtime_error(std::string(name) + " does not look like '123-234' or '0-50,10000-10050': " + std::make_error_code(ec).message());
+  }
+  return rangeSet;
+}
+
+
+/**
+ * A FILE* (for Printers) that calls a parquet_tools_write_fn.
+ *
+ * When the callback returns nonzero, the write fails: ferror() is set, and
+ * streamParquet() stops as if a reader had hung up.
+ */
+struct CallbackFile {
+  parquet_tools_write_fn write;
+  void* userData;
+
+  static ssize_t cookieWrite(void* cookie, const char* data, size_t size) {
+    CallbackFile* file = static_cast<CallbackFile*>(cookie);
+    return file->write(file->userData, data, size) == 0 ? size : -1;
+  }
+
+  FILE* open() {
+    if (this->write == nullptr) {
+      throw std::runtime_error("write must be set");
+    }
+    cookie_io_functions_t functions = { nullptr, &CallbackFile::cookieWrite, nullptr, nullptr };
+    FILE* fp = fopencookie(this, "w", functions);
+    if (fp == nullptr) {
+      throw std::runtime_error(std::string("Failed to open output: ") + std::strerror(errno));
+    }
+    return fp;
+  }
+};
+
+
+/**
+ * A std::streambuf (for diff()) that calls a parquet_tools_write_fn with
+ * each 64KiB of output, and on sync().
+ *
+ * Once the callback returns nonzero, we stop calling it and fail() the
+ * stream.
+ */
+class CallbackStreambuf : public std::streambuf {
+  parquet_tools_write_fn write;
+  void* userData;
+  std::vector<char> buffer;
+  bool failed;
+
+public:
+  CallbackStreambuf(parquet_tools_write_fn write_, void* userData_)
+    : write(write_)
+    , userData(userData_)
+    , buffer(64 * 1024)
+    , failed(false)
+  {
+    this->setp(this->buffer.data(), this->buffer.data() + this->buffer.size());
+  }
+
+  bool writeFailed() const { return this->failed; }
+
+protected:
+  int overflow(int c) override {
+    if (this->sync() != 0) return traits_type::eof();
+    if (c != traits_type::eof()) {
+      *this->pptr() = traits_type::to_char_type(c);
+      this->pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override {
+    const size_t size = this->pptr() - this->pbase();
+    if (size > 0 && !this->failed && this->write(this->userData, this->pbase(), size) != 0) {
+      this->failed = true;
+    }
+    this->setp(this->buffer.data(), this->buffer.data() + this->buffer.size());
+    return this->failed ? -1 : 0;
+  }
+};
+
+
+extern "C" {
+
+void
+parquet_tools_reader_options_init(parquet_tools_reader_options* options)
+{
+  const ReaderOptions defaults;
+  options->mmap = defaults.mmap;
+  options->buffered_stream = defaults.bufferedStream;
+  options->buffer_size = defaults.bufferSize;
+}
+
+
+void
+parquet_tools_stream_options_init(parquet_tools_stream_options* options)
+{
+  const StreamOptions defaults;
+  options->format = "json";
+  options->column_range = nullptr;
+  options->row_range = nullptr;
+  options->max_rows = defaults.maxRows;
+  options->max_bytes = defaults.maxBytes;
+  options->sort_by = nullptr;
+  options->sort_memory = defaults.sortMemory;
+  options->dictionary_memory = defaults.dictionaryMemory;
+  options->prefetch_row_groups = defaults.prefetchRowGroups;
+  options->prefetch_bytes = defaults.prefetchBytes;
+  options->validate_utf8 = nullptr;
+  parquet_tools_reader_options_init(&options->reader);
+  options->write = nullptr;
+  options->user_data = nullptr;
+}
+
+
+void
+parquet_tools_diff_options_init(parquet_tools_diff_options* options)
+{
+  const DiffOptions defaults;
+  options->threads = defaults.threads;
+  options->max_differences = defaults.maxDifferences;
+  options->summary = defaults.summary;
+  options->loose_row_groups = defaults.looseRowGroups;
+  options->key = nullptr;
+  options->key_memory = defaults.keyMemory;
+  options->columns = nullptr;
+  options->row_range = nullptr;
+  options->arrow = defaults.arrow;
+  parquet_tools_reader_options_init(&options->reader);
+  options->write = nullptr;
+  options->user_data = nullptr;
+}
+
+
+int
+parquet_tools_to_arrow(const char* parquetPath, const char* arrowPath, const parquet_tools_reader_options* reader, char* error, size_t errorSize)
+{
+  try {
+    parquet_tools_reader_options defaults;
+    parquet_tools_reader_options_init(&defaults);
+    convertParquetToArrow(parquetPath, arrowPath, readerOptions(reader ? *reader : defaults));
+    return 0;
+  } catch (const std::exception& ex) {
+    setError(error, errorSize, ex.what());
+    return 1;
+  } catch (...) {
+    setError(error, errorSize, kUnknownError);
+    return 1;
+  }
+}
+
+
+int
+parquet_tools_stream(const char* parquetPath, const parquet_tools_stream_options* options, char* error, size_t errorSize)
+{
+  try {
+    StreamOptions streamOptions;
+    streamOptions.columns = parseRangeSetOption("column_range", options->column_range);
+    streamOptions.rows = parseRangeSetOption("row_range", options->row_range);
+    streamOptions.maxRows = options->max_rows;
+    streamOptions.maxBytes = options->max_bytes;
+    streamOptions.sortBy = optionalString(options->sort_by);
+    streamOptions.sortMemory = options->sort_memory;
+    streamOptions.dictionaryMemory = options->dictionary_memory;
+    streamOptions.prefetchRowGroups = options->prefetch_row_groups;
+    streamOptions.prefetchBytes = options->prefetch_bytes;
+    const std::string validateUtf8(optionalString(options->validate_utf8));
+    if (validateUtf8 == "error") {
+      streamOptions.utf8Validation = Utf8Validation::Error;
+    } else if (validateUtf8 == "replace") {
+      streamOptions.utf8Validation = Utf8Validation::Replace;
+    } else if (validateUtf8 != "") {
+      throw std::runtime_error("validate_utf8 must be 'error' or 'replace'");
+    }
+    streamOptions.reader = readerOptions(options->reader);
+
+    CallbackFile output { .write = options->write, .userData = options->user_data };
+    FILE* fp = output.open();
+    StreamResult result;
+    try {
+      Printers printers;
+      printers.push_back(makePrinter(optionalString(options->format), fp, streamOptions));
+      result = streamParquet(parquetPath, printers, streamOptions);
+    } catch (...) {
+      fclose(fp);
+      throw;
+    }
+    if (fclose(fp) != 0) {
+      result.outputFailed = true;
+    }
+    return result.outputFailed ? kOutputFailed : 0;
+  } catch (const std::exception& ex) {
+    setError(error, errorSize, ex.what());
+    return 1;
+  } catch (...) {
+    setError(error, errorSize, kUnknownError);
+    return 1;
+  }
+}
+
+
+int
+parquet_tools_diff(const char* path1, const char* path2, const parquet_tools_diff_options* options, char* error, size_t errorSize)
+{
+  try {
+    DiffOptions diffOptions;
+    diffOptions.threads = options->threads;
+    diffOptions.maxDifferences = options->max_differences;
+    diffOptions.summary = options->summary != 0;
+    diffOptions.looseRowGroups = options->loose_row_groups != 0;
+    diffOptions.key = optionalString(options->key);
+    diffOptions.keyMemory = options->key_memory;
+    diffOptions.columns = optionalString(options->columns);
+    diffOptions.rowRange = optionalString(options->row_range);
+    diffOptions.arrow = options->arrow != 0;
+    diffOptions.reader = readerOptions(options->reader);
+
+    if (options->write == nullptr) {
+      throw std::runtime_error("write must be set");
+    }
+    CallbackStreambuf streambuf(options->write, options->user_data);
+    std::ostream out(&streambuf);
+    const int result = diff(path1, path2, diffOptions, out);
+    out.flush();
+    if (streambuf.writeFailed()) {
+      throw std::runtime_error("Failed to write output");
+    }
+    return result;
+  } catch (const std::exception& ex) {
+    setError(error, errorSize, ex.what());
+    return 2;
+  } catch (...) {
+    setError(error, errorSize, kUnknownError);
+    return 2;
+  }
+}
+
+} // extern "C"
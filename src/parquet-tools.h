@@ -0,0 +1,120 @@
+/*
+ * libparquet-tools: parquet-to-arrow, parquet-to-text-stream and parquet-diff
+ * as C functions, so a program can call them without fork() and exec().
+ *
+ * Each function takes options that mirror its binary's flags, and returns
+ * what its binary would exit with. On error, it writes a message (what the
+ * binary writes to stderr) to `error`, truncated to `error_size` bytes
+ * including the trailing NUL.
+ *
+ * Functions are thread-safe: they share no state. Arrow and Parquet are
+ * linked in statically, with their symbols hidden, so they can't clash with
+ * another copy of Arrow in the same process (say, pyarrow's).
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PARQUET_TOOLS_EXPORT __attribute__((visibility("default")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Called with each piece of output, in order. Return 0 to continue, or
+ * anything else to stop (say, because the reader hung up).
+ */
+typedef int (*parquet_tools_write_fn)(void* user_data, const char* data, size_t size);
+
+/**
+ * How to read a Parquet file: --mmap, --buffered-stream and --buffer-size.
+ */
+struct parquet_tools_reader_options {
+  int mmap;
+  int buffered_stream;
+  int64_t buffer_size;
+};
+
+struct parquet_tools_stream_options {
+  const char* format; /* "csv" or "json" */
+  const char* column_range; /* --column-range; NULL or "" for all */
+  const char* row_range; /* --row-range; NULL or "" for all */
+  int64_t max_rows; /* -1 for no limit */
+  int64_t max_bytes; /* -1 for no limit */
+  const char* sort_by; /* --sort-by; NULL or "" to keep file order */
+  int64_t sort_memory; /* bytes of rows to sort in RAM; more spill to temporary files */
+  int64_t dictionary_memory; /* bytes of dictionaries to hold in RAM; more spill (-1 for no limit) */
+  int32_t prefetch_row_groups;
+  int64_t prefetch_bytes; /* bytes of read-ahead to hold in RAM */
+  const char* validate_utf8; /* NULL, "error" or "replace" */
+  struct parquet_tools_reader_options reader;
+  parquet_tools_write_fn write;
+  void* user_data;
+};
+
+struct parquet_tools_diff_options {
+  int32_t threads; /* 0 means one per CPU */
+  int64_t max_differences;
+  int summary;
+  int loose_row_groups;
+  const char* key; /* --key; NULL or "" to compare rows in order */
+  int64_t key_memory; /* with key, bytes of rows to hold in RAM (-1 for no limit) */
+  const char* columns; /* --columns; NULL or "" for all */
+  const char* row_range; /* --row-range; NULL or "" for all */
+  int arrow; /* file 2 is an Arrow IPC file */
+  struct parquet_tools_reader_options reader;
+  parquet_tools_write_fn write;
+  void* user_data;
+};
+
+/** Set every option to its binary's default. Set `write` yourself. */
+PARQUET_TOOLS_EXPORT void parquet_tools_reader_options_init(struct parquet_tools_reader_options* options);
+PARQUET_TOOLS_EXPORT void parquet_tools_stream_options_init(struct parquet_tools_stream_options* options);
+PARQUET_TOOLS_EXPORT void parquet_tools_diff_options_init(struct parquet_tools_diff_options* options);
+
+/**
+ * Convert a Parquet file to an Arrow IPC file, like parquet-to-arrow.
+ *
+ * `reader` may be NULL, for defaults. Return 0, or 1 on error.
+ */
+PARQUET_TOOLS_EXPORT int parquet_tools_to_arrow(
+  const char* parquet_path,
+  const char* arrow_path,
+  const struct parquet_tools_reader_options* reader,
+  char* error,
+  size_t error_size
+);
+
+/**
+ * Write a Parquet file as CSV or JSON to `options->write`, like
+ * parquet-to-text-stream.
+ *
+ * Return 0; 1 on error; or 141 if `options->write` asked us to stop.
+ */
+PARQUET_TOOLS_EXPORT int parquet_tools_stream(
+  const char* parquet_path,
+  const struct parquet_tools_stream_options* options,
+  char* error,
+  size_t error_size
+);
+
+/**
+ * Compare two files, like parquet-diff, writing differences to
+ * `options->write`.
+ *
+ * Return 0 if they're equal; 1 if they differ; or 2 on error (including an
+ * invalid Parquet file or a page we can't decode).
+ */
+PARQUET_TOOLS_EXPORT int parquet_tools_diff(
+  const char* path1,
+  const char* path2,
+  const struct parquet_tools_diff_options* options,
+  char* error,
+  size_t error_size
+);
+
+#ifdef __cplusplus
+}
+#endif
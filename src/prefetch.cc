@@ -0,0 +1,200 @@
+#include <cstring>
+#include <arrow/buffer.h>
+#include <parquet/metadata.h>
+
+#include "prefetch.h"
+
+
+PrefetchingFile::PrefetchingFile(std::shared_ptr<arrow::io::RandomAccessFile> file_, int depth_, int64_t maxBytes_)
+  : file(file_)
+  , depth(depth_)
+  , maxBytes(maxBytes_)
+  , consumedRank(-1)
+  , heldBytes(0)
+  , stopping(false)
+{
+}
+
+PrefetchingFile::~PrefetchingFile()
+{
+  this->stop();
+}
+
+void
+PrefetchingFile::start(const parquet::FileMetaData& metadata, const std::vector<int>& rowGroups, const std::vector<int>& columns)
+{
+  if (this->depth <= 0 || this->maxBytes <= 0 || rowGroups.empty() || columns.empty()) {
+    return; // nothing to do, and no thread to join
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (size_t rank = 0; rank < rowGroups.size(); rank++) {
+      std::unique_ptr<parquet::RowGroupMetaData> rowGroup(metadata.RowGroup(rowGroups[rank]));
+      for (int columnIndex : columns) {
+        std::unique_ptr<parquet::ColumnChunkMetaData> column(rowGroup->ColumnChunk(columnIndex));
+
+        // Same range ParquetFileReader computes for the chunk
+        int64_t start = column->data_page_offset();
+        if (
+          column->has_dictionary_page()
+          && column->dictionary_page_offset() > 0
+          && start > column->dictionary_page_offset()
+        ) {
+          start = column->dictionary_page_offset();
+        }
+
+        this->chunkIndexByOffset[start] = this->chunks.size();
+        this->chunks.push_back(Chunk {
+          .rank = static_cast<int>(rank),
+          .offset = start,
+          .length = column->total_compressed_size(),
+          .state = ChunkState::Pending,
+          .buffer = nullptr
+        });
+      }
+    }
+  }
+
+  this->worker = std::thread(&PrefetchingFile::run, this);
+}
+
+void
+PrefetchingFile::run()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  for (Chunk& chunk : this->chunks) {
+    this->changed.wait(lock, [this, &chunk]() {
+      return this->stopping
+        || chunk.state != ChunkState::Pending
+        || (
+          chunk.rank <= this->consumedRank + this->depth
+          && (chunk.length > this->maxBytes || this->heldBytes + chunk.length <= this->maxBytes)
+        );
+    });
+    if (this->stopping) return;
+    if (chunk.state != ChunkState::Pending) continue; // the reader got here first
+    if (chunk.length > this->maxBytes) continue; // the reader will read it itself
+
+    chunk.state = ChunkState::Fetching;
+    lock.unlock();
+    arrow::Result<std::shared_ptr<arrow::Buffer>> result(this->file->ReadAt(chunk.offset, chunk.length));
+    lock.lock();
+
+    if (result.ok() && result.ValueOrDie()->size() == chunk.length) {
+      chunk.buffer = result.ValueOrDie();
+      chunk.state = ChunkState::Ready;
+      this->heldBytes += chunk.length;
+    } else {
+      // Let the reader read it again and report the error itself
+      chunk.state = ChunkState::Pending;
+    }
+    this->changed.notify_all();
+  }
+}
+
+void
+PrefetchingFile::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->changed.notify_all();
+  if (this->worker.joinable()) {
+    this->worker.join();
+  }
+}
+
+std::shared_ptr<arrow::Buffer>
+PrefetchingFile::take(int64_t position, int64_t nbytes)
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  auto it = this->chunkIndexByOffset.upper_bound(position);
+  if (it == this->chunkIndexByOffset.begin()) return nullptr;
+  Chunk& chunk = this->chunks[std::prev(it)->second];
+  if (position + nbytes > chunk.offset + chunk.length) return nullptr;
+
+  if (chunk.rank > this->consumedRank) {
+    this->consumedRank = chunk.rank;
+    this->changed.notify_all(); // the worker may read further ahead now
+  }
+
+  this->changed.wait(lock, [&chunk]() { return chunk.state != ChunkState::Fetching; });
+
+  std::shared_ptr<arrow::Buffer> buffer;
+  if (chunk.state == ChunkState::Ready) {
+    buffer = arrow::SliceBuffer(chunk.buffer, position - chunk.offset, nbytes);
+    chunk.buffer.reset();
+    this->heldBytes -= chunk.length;
+    this->changed.notify_all(); // the worker may have room for more now
+  }
+  chunk.state = ChunkState::Consumed;
+  return buffer;
+}
+
+arrow::Status
+PrefetchingFile::Close()
+{
+  this->stop();
+  return this->file->Close();
+}
+
+bool
+PrefetchingFile::closed() const
+{
+  return this->file->closed();
+}
+
+arrow::Result<int64_t>
+PrefetchingFile::Tell() const
+{
+  return this->file->Tell();
+}
+
+arrow::Status
+PrefetchingFile::Seek(int64_t position)
+{
+  return this->file->Seek(position);
+}
+
+arrow::Result<int64_t>
+PrefetchingFile::Read(int64_t nbytes, void* out)
+{
+  return this->file->Read(nbytes, out);
+}
+
+arrow::Result<std::shared_ptr<arrow::Buffer>>
+PrefetchingFile::Read(int64_t nbytes)
+{
+  return this->file->Read(nbytes);
+}
+
+arrow::Result<int64_t>
+PrefetchingFile::GetSize()
+{
+  return this->file->GetSize();
+}
+
+arrow::Result<int64_t>
+PrefetchingFile::ReadAt(int64_t position, int64_t nbytes, void* out)
+{
+  std::shared_ptr<arrow::Buffer> buffer(this->take(position, nbytes));
+  if (buffer) {
+    std::memcpy(out, buffer->data(), nbytes);
+    return nbytes;
+  }
+  return this->file->ReadAt(position, nbytes, out);
+}
+
+arrow::Result<std::shared_ptr<arrow::Buffer>>
+PrefetchingFile::ReadAt(int64_t position, int64_t nbytes)
+{
+  std::shared_ptr<arrow::Buffer> buffer(this->take(position, nbytes));
+  if (buffer) {
+    return buffer;
+  }
+  return this->file->ReadAt(position, nbytes);
+}
@@ -0,0 +1,90 @@
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <arrow/io/interfaces.h>
+#include <parquet/metadata.h>
+
+/**
+ * A file that reads upcoming column chunks on a background thread.
+ *
+ * ParquetFileReader (with buffered streams disabled, the default) reads each
+ * column chunk with a single ReadAt() when a RowGroupReader opens it. That
+ * means a synchronous disk read for every column at every row-group boundary.
+ *
+ * After start(), a worker thread reads the planned column chunks in order and
+ * holds their bytes. When the ParquetFileReader asks for a range inside a
+ * planned chunk, we hand over the prefetched buffer (zero-copy) and forget
+ * it. Ranges we did not plan (the footer, skipped row groups) fall through to
+ * the underlying file.
+ *
+ * Two knobs bound the work:
+ *
+ * * `depth`: the worker stays at most this many row groups ahead of the last
+ *   row group the reader asked for.
+ * * `maxBytes`: the worker never holds more than this many unconsumed bytes.
+ *   A chunk larger than maxBytes is never prefetched.
+ *
+ * We do not use Arrow's PreBuffer(): we build Arrow without its IO thread pool
+ * (see arrow-patches/).
+ */
+class PrefetchingFile : public arrow::io::RandomAccessFile {
+public:
+  PrefetchingFile(std::shared_ptr<arrow::io::RandomAccessFile> file, int depth, int64_t maxBytes);
+  ~PrefetchingFile() override;
+
+  /**
+   * Begin prefetching `columns` of `rowGroups`, in row-group-major order.
+   *
+   * Call at most once, after the ParquetFileReader has read the footer.
+   */
+  void start(const parquet::FileMetaData& metadata, const std::vector<int>& rowGroups, const std::vector<int>& columns);
+
+  arrow::Status Close() override;
+  bool closed() const override;
+  arrow::Result<int64_t> Tell() const override;
+  arrow::Status Seek(int64_t position) override;
+  arrow::Result<int64_t> Read(int64_t nbytes, void* out) override;
+  arrow::Result<std::shared_ptr<arrow::Buffer>> Read(int64_t nbytes) override;
+  arrow::Result<int64_t> GetSize() override;
+  using arrow::io::RandomAccessFile::ReadAt;
+  arrow::Result<int64_t> ReadAt(int64_t position, int64_t nbytes, void* out) override;
+  arrow::Result<std::shared_ptr<arrow::Buffer>> ReadAt(int64_t position, int64_t nbytes) override;
+
+private:
+  enum class ChunkState { Pending, Fetching, Ready, Consumed };
+
+  struct Chunk {
+    int rank; // index of the row group within the plan
+    int64_t offset;
+    int64_t length;
+    ChunkState state;
+    std::shared_ptr<arrow::Buffer> buffer; // set iff state == Ready
+  };
+
+  std::shared_ptr<arrow::io::RandomAccessFile> file;
+  const int depth;
+  const int64_t maxBytes;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<Chunk> chunks;
+  std::map<int64_t, size_t> chunkIndexByOffset;
+  int consumedRank; // highest plan rank the reader has asked for
+  int64_t heldBytes;
+  bool stopping;
+  std::thread worker;
+
+  void run();
+  void stop();
+
+  /**
+   * Take the prefetched bytes for [position, position + nbytes), if we have them.
+   *
+   * Return nullptr if the caller must read the range itself.
+   */
+  std::shared_ptr<arrow::Buffer> take(int64_t position, int64_t nbytes);
+};
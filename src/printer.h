@@ -0,0 +1,483 @@
+#include <array>
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <double-conversion/double-conversion.h> // already a dep of arrow; and printf won't do
+
+#include "vendor/gcc/sys_date_to_ymd_string.h"
+#include "utf8.h"
+
+/*
+ * Writing values as CSV or JSON.
+ *
+ * Include column-iterator.h first: Printers write its Date and Timestamp*
+ * types.
+ */
+
+
+class Printer {
+  static const int kBufferSize = 128; // the number in https://github.com/google/double-conversion/blob/master/test/cctest/test-conversions.cc
+  std::array<char, kBufferSize> doubleBuffer;
+  double_conversion::StringBuilder doubleBuilder;
+  const double_conversion::DoubleToStringConverter& doubleConverter;
+  FILE* out; // the output
+  char* recordBufferData; // when buffering records: open_memstream() data
+  size_t recordBufferSize; // when buffering records: open_memstream() size
+  int64_t nBytesWritten; // when buffering records: bytes committed to `out`
+
+protected:
+  FILE* fp; // `out`, or (when buffering records) the record buffer
+  Utf8Validation utf8Validation;
+
+public:
+  /**
+   * Create a Printer that writes to `out_`.
+   *
+   * If `bufferRecords_` is set, the Printer writes to a buffer instead, and
+   * the caller decides whether to commitBuffer() or discardBuffer() after
+   * each record. That costs a copy, so only do it to enforce --max-bytes.
+   */
+  Printer(FILE* out_, Utf8Validation utf8Validation_, bool bufferRecords_)
+    : doubleBuilder(&this->doubleBuffer[0], this->kBufferSize)
+    , doubleConverter(double_conversion::DoubleToStringConverter::EcmaScriptConverter())
+    , out(out_)
+    , recordBufferData(nullptr)
+    , recordBufferSize(0)
+    , nBytesWritten(0)
+    , fp(out_)
+    , utf8Validation(utf8Validation_)
+  {
+    if (bufferRecords_) {
+      this->fp = open_memstream(&this->recordBufferData, &this->recordBufferSize);
+      if (this->fp == nullptr) {
+        throw std::runtime_error(std::string("Failed to allocate record buffer: ") + std::strerror(errno));
+      }
+    }
+  }
+
+  virtual ~Printer() {
+    if (this->fp != this->out) {
+      fclose(this->fp);
+      free(this->recordBufferData);
+    }
+  }
+
+  /**
+   * Return the number of bytes written since the last commitBuffer() or
+   * discardBuffer(). Only valid when buffering records.
+   */
+  size_t bufferedSize() {
+    fflush(this->fp); // updates recordBufferSize
+    return this->recordBufferSize;
+  }
+
+  /**
+   * Return the bytes written since the last commitBuffer() or discardBuffer().
+   * Only valid when buffering records; invalid after the next write.
+   */
+  std::string_view bufferedBytes() {
+    const size_t size = this->bufferedSize();
+    return std::string_view(this->recordBufferData, size);
+  }
+
+  /**
+   * Write bytes we formatted earlier (e.g., a sorted record's fields).
+   */
+  void writeRaw(std::string_view bytes) {
+    fwrite_unlocked(bytes.data(), 1, bytes.size(), this->fp);
+  }
+
+  /**
+   * Copy buffered bytes to the output. No-op when not buffering records.
+   */
+  void commitBuffer() {
+    if (this->fp != this->out) {
+      const size_t size = this->bufferedSize();
+      fwrite_unlocked(this->recordBufferData, 1, size, this->out);
+      this->nBytesWritten += size;
+      rewind(this->fp);
+    }
+  }
+
+  /**
+   * Forget buffered bytes. Only valid when buffering records.
+   */
+  void discardBuffer() {
+    rewind(this->fp);
+  }
+
+  /**
+   * Return the number of bytes committed to the output. Only valid when
+   * buffering records.
+   */
+  int64_t bytesWritten() const { return this->nBytesWritten; }
+
+  /**
+   * Return true if a write to the output failed (e.g., with EPIPE).
+   *
+   * stdio buffers output, so we notice a few kilobytes after the fact.
+   */
+  bool failed() const { return ferror_unlocked(this->out); }
+
+  void flush() {
+    this->commitBuffer();
+    fflush(this->out);
+  }
+
+  virtual void writeFileHeader() = 0; // JSON '['
+  virtual void writeFileFooter() = 0; // JSON ']'
+  virtual void writeRecordStart(int rowIndex) = 0; // JSON '{'; CSV '\r\n'
+  virtual void writeRecordStop() = 0; // JSON '}'
+  virtual void writeFieldStart(int columnIndex, std::string_view name) = 0; // JSON field name; CSV comma
+  virtual void writeHeaderField(int columnIndex, std::string_view name) = 0; // CSV field name
+
+  virtual void writeNull() = 0; // CSV '', JSON 'null'
+  virtual void writeString(std::string_view value) = 0; // escaped; may throw InvalidUtf8Error
+
+  void write(TimestampMillis value) { this->writeTimestamp(value.value, 3); }
+  void write(TimestampMicros value) { this->writeTimestamp(value.value, 6); }
+  void write(TimestampNanos value) { this->writeTimestamp(value.value, 9); }
+  void write(std::string_view value) { this->writeString(value); }
+
+  // It just so happens JSON and CSV write numbers exactly the same way:
+  void write(float value) {
+    if (std::isfinite(value)) {
+      this->doubleBuilder.Reset();
+      if (this->doubleConverter.ToShortestSingle(value, &this->doubleBuilder)) {
+        // No need to call this->doubleBuilder.Finalize() because we know
+        // where the string ends.
+        fwrite_unlocked(&this->doubleBuffer[0], 1, this->doubleBuilder.position(), this->fp);
+      } else {
+        std::cerr << "Failed to convert float: " << value << std::endl;
+        // I guess we can recover from this. According to the docs, there's no
+        // way for this to ever happen anyway.
+      }
+    } else {
+      // Text mode: NaN, +inf and -inf are all null (empty string)
+      this->writeNull();
+    }
+  }
+
+  void write(double value) {
+    if (std::isfinite(value)) {
+      this->doubleBuilder.Reset();
+      if (this->doubleConverter.ToShortest(value, &this->doubleBuilder)) {
+        // No need to call this->doubleBuilder.Finalize() because we know
+        // where the string ends.
+        fwrite_unlocked(&this->doubleBuffer[0], 1, this->doubleBuilder.position(), this->fp);
+      } else {
+        std::cerr << "Failed to convert float: " << value << std::endl;
+        // I guess we can recover from this. According to the docs, there's no
+        // way for this to ever happen anyway.
+      }
+    } else {
+      // Text mode: NaN, +inf and -inf are all null (empty string)
+      this->writeNull();
+    }
+  }
+
+  void write(int32_t value) { fprintf(this->fp, "%" PRIi32, value); }
+  void write(int64_t value) { fprintf(this->fp, "%" PRIi64, value); }
+  void write(uint32_t value) { fprintf(this->fp, "%" PRIu32, value); }
+  void write(uint64_t value) { fprintf(this->fp, "%" PRIu64, value); }
+
+  void write(Date value) {
+    char buf[] = "YYYY-MM-DD"; // correct size and initialized
+    write_day_since_epoch_as_yyyy_mm_dd(value.value, &buf[0]);
+    this->writeString(std::string_view(buf, 10));
+  }
+
+protected:
+
+  virtual void writeTimestamp(int64_t value, int nFractionDigits) = 0;
+
+  void writeRawShortISO8601UTCTimestamp(int64_t value, int nFractionDigits) {
+    int64_t epochSeconds;
+    int subsecondFraction;
+    switch (nFractionDigits) {
+      case 3:
+        epochSeconds = value / 1000;
+        subsecondFraction = value % 1000;
+        if (value < 0  && subsecondFraction != 0) {
+          epochSeconds -= 1;
+          subsecondFraction = (subsecondFraction + 1000) % 1000;
+        }
+        break;
+      case 6:
+        epochSeconds = value / 1000000;
+        subsecondFraction = value % 1000000;
+        if (value < 0  && subsecondFraction != 0) {
+          epochSeconds -= 1;
+          subsecondFraction = (subsecondFraction + 1000000) % 1000000;
+        }
+        break;
+      case 9:
+        epochSeconds = value / 1000000000;
+        subsecondFraction = value % 1000000000;
+        if (value < 0  && subsecondFraction != 0) {
+          epochSeconds -= 1;
+          subsecondFraction = (subsecondFraction + 1000000000) % 1000000000;
+        }
+        break;
+      default:
+        std::cerr << "Failure: unsupported nFractionDigits " << nFractionDigits << std::endl;
+        std::_Exit(1);
+    }
+
+    struct tm time = { .tm_sec=0, .tm_min=0, .tm_hour=0, .tm_mday=0, .tm_mon=0, .tm_year=0, .tm_wday=0, .tm_yday=0, .tm_isdst=0 };
+    const time_t timeInput = static_cast<time_t>(epochSeconds);
+    gmtime_r(&timeInput, &time);
+
+    // We always print date
+    fprintf(this->fp, "%04d-%02d-%02d", time.tm_year + 1900, time.tm_mon + 1, time.tm_mday);
+
+    // "Auto-format" time: only print the resolution it uses.
+    //
+    // This is perfect for CSV, because it uses fewer characters, transmits
+    // the same information, adheres to ISO8601, and is easier to read.
+    //
+    // * If ns=0, only show us (YYYY-MM-DDTHH:MM:SS.ssssss)
+    // * If us=0, only show ms (YYYY-MM-DDTHH:MM:SS.sss)
+    // * If ms=0, only show s (YYYY-MM-DDTHH:MM:SS)
+    // * If h=0, m=0, s=0, only show date (YYYY-MM-DD)
+    while (nFractionDigits > 0 && subsecondFraction % 1000 == 0) {
+      subsecondFraction /= 1000;
+      nFractionDigits -= 3;
+    }
+    if (nFractionDigits == 0) {
+      if (time.tm_min == 0 && time.tm_sec == 0) {
+        fprintf(this->fp, "T%02dZ", time.tm_hour);
+      } else if (time.tm_sec == 0) {
+        fprintf(this->fp, "T%02d:%02dZ", time.tm_hour, time.tm_min);
+      } else {
+        fprintf(this->fp, "T%02d:%02d:%02dZ", time.tm_hour, time.tm_min, time.tm_sec);
+      }
+    } else if (nFractionDigits == 3) {
+      fprintf(this->fp, "T%02d:%02d:%02d.%03dZ", time.tm_hour, time.tm_min, time.tm_sec, subsecondFraction);
+    } else if (nFractionDigits == 6) {
+      fprintf(this->fp, "T%02d:%02d:%02d.%06dZ", time.tm_hour, time.tm_min, time.tm_sec, subsecondFraction);
+    } else if (nFractionDigits == 9) {
+      fprintf(this->fp, "T%02d:%02d:%02d.%09dZ", time.tm_hour, time.tm_min, time.tm_sec, subsecondFraction);
+    }
+  }
+};
+
+
+typedef std::vector<std::unique_ptr<Printer>> Printers;
+
+
+struct CsvPrinter : public Printer {
+  CsvPrinter(FILE* aFp, Utf8Validation utf8Validation, bool bufferRecords) : Printer(aFp, utf8Validation, bufferRecords) {}
+
+  void writeFileHeader() override {}
+  void writeFileFooter() override {}
+  void writeRecordStop() override {}
+
+  void writeRecordStart(int rowIndex) override {
+    // newline -- start new CSV record
+    // RFC4180 says CRLF: https://datatracker.ietf.org/doc/html/rfc4180#section-2
+    fputc_unlocked('\r', this->fp);
+    fputc_unlocked('\n', this->fp);
+  }
+
+  void writeFieldStart(int columnIndex, std::string_view name) override {
+    if (columnIndex > 0) {
+      fputc_unlocked(',', this->fp);
+    }
+  }
+
+  void writeHeaderField(int columnIndex, std::string_view name) override {
+    this->writeFieldStart(columnIndex, name);
+    this->writeString(name);
+  }
+
+  void writeNull() override {
+    // CSV: null is empty string. Write nothing.
+  }
+
+  void writeString(std::string_view value) override {
+    // Find out whether we need quotes. While we're at it, validate UTF-8.
+    // (UTF-8 continuation bytes are never ASCII, so it's okay to
+    // ascii-compare.)
+    bool needQuote = false;
+    const bool validate = this->utf8Validation != Utf8Validation::None;
+    const uint64_t highBits = validate ? swar::kHighBits : 0;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(value.data());
+    const uint8_t* end = p + value.size();
+    while (p < end && !(needQuote && !validate)) {
+      if (end - p >= 8) {
+        uint64_t word = swar::load(p);
+        if (
+          !(word & highBits)
+          && (
+            needQuote
+            || !(swar::hasByte(word, '"') | swar::hasByte(word, ',') | swar::hasByte(word, '\n') | swar::hasByte(word, '\r'))
+          )
+        ) {
+          p += 8; // 8 bytes of nothing interesting
+          continue;
+        }
+      }
+
+      const uint8_t c = *p;
+      if (c < 0x80 || !validate) {
+        if (c == '"' || c == ',' || c == '\n' || c == '\r') {
+          needQuote = true;
+        }
+        p++;
+      } else if (int n = utf8SequenceLength(p, end)) {
+        p += n;
+      } else if (this->utf8Validation == Utf8Validation::Error) {
+        throw InvalidUtf8Error();
+      } else {
+        // Rare: write a valid copy instead
+        this->writeString(utf8Replace(value));
+        return;
+      }
+    }
+
+    if (!needQuote) {
+      fwrite_unlocked(value.data(), 1, value.size(), this->fp);
+    } else {
+      fputc_unlocked('"', this->fp);
+      size_t nWritten = 0;
+      while (nWritten < value.size()) {
+        const size_t quote_pos = value.find('"', nWritten);
+        if (quote_pos == std::string::npos) {
+          // No more quotation marks
+          fwrite_unlocked(value.data() + nWritten, 1, value.size() - nWritten, this->fp);
+          nWritten = value.size();
+        } else {
+          fwrite_unlocked(value.data() + nWritten, 1, quote_pos - nWritten, this->fp);
+          fwrite_unlocked("\"\"", 1, 2, this->fp);
+          nWritten = quote_pos + 1;
+        }
+      }
+      fputc_unlocked('"', this->fp);
+    }
+  }
+
+  void writeTimestamp(int64_t value, int nFractionDigits) override {
+    this->writeRawShortISO8601UTCTimestamp(value, nFractionDigits);
+  }
+};
+
+
+struct JsonPrinter : public Printer {
+  JsonPrinter(FILE* aFp, Utf8Validation utf8Validation, bool bufferRecords) : Printer(aFp, utf8Validation, bufferRecords) {}
+
+  void writeFileHeader() override {
+    fputc_unlocked('[', this->fp); // begin array
+  }
+
+  void writeFileFooter() override {
+    fputc_unlocked(']', this->fp); // end array
+  }
+
+  void writeRecordStart(int rowIndex) override {
+    if (rowIndex != 0) {
+      fputc_unlocked(',', this->fp);
+    }
+    fputc_unlocked('{', this->fp); // begin object
+  }
+
+  void writeRecordStop() override {
+    fputc_unlocked('}', this->fp); // end object
+  }
+
+  void writeFieldStart(int columnIndex, std::string_view name) override {
+    if (columnIndex > 0) {
+      fputc_unlocked(',', this->fp);
+    }
+    this->writeString(name);
+    fputc_unlocked(':', this->fp);
+  }
+
+  void writeHeaderField(int columnIndex, std::string_view name) override {
+    // JSON has no header
+  }
+
+  void writeNull() override {
+    fwrite_unlocked("null", 1, 4, this->fp);
+  }
+
+  void writeString(std::string_view value) override {
+    fputc_unlocked('"', this->fp);
+
+    // Write runs of bytes that need no escaping with a single fwrite(). While
+    // we're at it, validate UTF-8. (UTF-8 continuation bytes are never ASCII,
+    // so it's okay to ascii-compare.)
+    const bool validate = this->utf8Validation != Utf8Validation::None;
+    const uint64_t highBits = validate ? swar::kHighBits : 0;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(value.data());
+    const uint8_t* end = p + value.size();
+    const uint8_t* run = p; // start of bytes we haven't written yet
+    while (p < end) {
+      if (end - p >= 8) {
+        uint64_t word = swar::load(p);
+        if (
+          !(word & highBits)
+          && !(swar::hasLess(word, 0x20) | swar::hasByte(word, '"') | swar::hasByte(word, '\\'))
+        ) {
+          p += 8; // 8 bytes that need no escaping
+          continue;
+        }
+      }
+
+      const uint8_t c = *p;
+      if (c >= 0x80) {
+        if (!validate) {
+          p++;
+        } else if (int n = utf8SequenceLength(p, end)) {
+          p += n;
+        } else if (this->utf8Validation == Utf8Validation::Error) {
+          throw InvalidUtf8Error();
+        } else {
+          fwrite_unlocked(run, 1, p - run, this->fp);
+          fwrite_unlocked(kUtf8ReplacementCharacter, 1, 3, this->fp);
+          p += utf8InvalidLength(p, end);
+          run = p;
+        }
+        continue;
+      }
+
+      if (c >= 0x20 && c != '"' && c != '\\') {
+        p++;
+        continue;
+      }
+
+      fwrite_unlocked(run, 1, p - run, this->fp);
+      switch (c) {
+        case '"': fwrite_unlocked("\\\"", 1, 2, this->fp); break;
+        case '\\': fwrite_unlocked("\\\\", 1, 2, this->fp); break;
+        case '\b': fwrite_unlocked("\\b", 1, 2, this->fp); break;
+        case '\f': fwrite_unlocked("\\f", 1, 2, this->fp); break;
+        case '\n': fwrite_unlocked("\\n", 1, 2, this->fp); break;
+        case '\r': fwrite_unlocked("\\r", 1, 2, this->fp); break;
+        case '\t': fwrite_unlocked("\\t", 1, 2, this->fp); break;
+        default: fprintf(this->fp, "\\u%04hhd", c);
+      }
+      p++;
+      run = p;
+    }
+    fwrite_unlocked(run, 1, p - run, this->fp);
+
+    fputc_unlocked('"', this->fp);
+  }
+
+  void writeTimestamp(int64_t value, int nFractionDigits) override {
+    fputc_unlocked('"', this->fp);
+    this->writeRawShortISO8601UTCTimestamp(value, nFractionDigits);
+    fputc_unlocked('"', this->fp);
+  }
+};
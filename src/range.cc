@@ -1,7 +1,103 @@
 #include <charconv>
+#include <iostream>
 
 #include "range.h"
 
+RangeSet::RangeSet(std::vector<Range> ranges_)
+{
+  std::sort(ranges_.begin(), ranges_.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+  for (const Range& range : ranges_) {
+    if (range.size() == 0) continue;
+
+    if (!this->ranges.empty() && range.start <= this->ranges.back().stop) {
+      this->ranges.back().stop = std::max(this->ranges.back().stop, range.stop);
+    } else {
+      this->ranges.push_back(range);
+    }
+  }
+}
+
+
+uint64_t
+RangeSet::size() const
+{
+  uint64_t ret = 0;
+  for (const Range& range : this->ranges) {
+    ret += range.size();
+  }
+  return ret;
+}
+
+
+bool
+RangeSet::includes(uint64_t i) const
+{
+  // The first range that stops after i is the only one that may include it
+  auto it = std::upper_bound(this->ranges.begin(), this->ranges.end(), i, [](uint64_t value, const Range& range) { return value < range.stop; });
+  return it != this->ranges.end() && it->includes(i);
+}
+
+
+RangeSet
+RangeSet::clip(uint64_t max) const
+{
+  std::vector<Range> ret;
+  for (const Range& range : this->ranges) {
+    ret.push_back(range.clip(max));
+  }
+  return RangeSet(ret);
+}
+
+
+RangeSet
+RangeSet::limit(uint64_t n) const
+{
+  std::vector<Range> ret;
+  for (const Range& range : this->ranges) {
+    if (n == 0) break;
+    ret.push_back(Range(range.start, range.start + std::min(n, range.size())));
+    n -= ret.back().size();
+  }
+  return RangeSet(ret);
+}
+
+
+std::vector<uint64_t>
+RangeSet::values() const
+{
+  std::vector<uint64_t> ret;
+  for (const Range& range : this->ranges) {
+    for (uint64_t i = range.start; i < range.stop; i++) {
+      ret.push_back(i);
+    }
+  }
+  return ret;
+}
+
+
+std::vector<RowGroupPlan>
+RangeSet::planRowGroups(const std::vector<uint64_t>& rowGroupSizes) const
+{
+  std::vector<RowGroupPlan> ret;
+  auto range = this->ranges.begin();
+  uint64_t rowGroupStart = 0;
+  for (size_t i = 0; i < rowGroupSizes.size() && range != this->ranges.end(); i++) {
+    const uint64_t rowGroupStop = rowGroupStart + rowGroupSizes[i];
+    RowGroupPlan plan { .rowGroup = static_cast<int>(i), .firstRow = rowGroupStart, .rows = {} };
+    // Each range that starts in this row group, plus one that started before
+    for (; range != this->ranges.end() && range->start < rowGroupStop; range++) {
+      plan.rows.push_back(Range(std::max(range->start, rowGroupStart) - rowGroupStart, std::min(range->stop, rowGroupStop) - rowGroupStart));
+      if (range->stop > rowGroupStop) break; // it continues in the next row group
+    }
+    if (!plan.rows.empty()) {
+      ret.push_back(std::move(plan));
+    }
+    rowGroupStart = rowGroupStop;
+  }
+  return ret;
+}
+
+
 ParseRangeResult
 parse_range(const char* begin, const char* end)
 {
@@ -17,8 +113,8 @@ parse_range(const char* begin, const char* end)
 
   uint64_t stop = 0; // avoid "uninitialized" compiler warning
   auto [after_stop, ec2] = std::from_chars(after_start + 1, end, stop);
-  if (ec != std::errc()) {
-    return { Range(0, 0), ec };
+  if (ec2 != std::errc()) {
+    return { Range(0, 0), ec2 };
   }
   if (after_stop != end) {
     return { Range(0, 0), std::errc::invalid_argument };
@@ -31,3 +127,35 @@ parse_range(const char* begin, const char* end)
   return { Range(start, stop), std::errc() };
 }
 
+
+ParseRangeSetResult
+parse_range_set(const char* begin, const char* end)
+{
+  std::vector<Range> ranges;
+  while (true) {
+    const char* comma = std::find(begin, end, ',');
+    auto [range, ec] = parse_range(begin, comma);
+    if (ec != std::errc()) {
+      return { RangeSet(std::vector<Range>()), ec };
+    }
+    ranges.push_back(range);
+    if (comma == end) break;
+    begin = comma + 1;
+  }
+  return { RangeSet(ranges), std::errc() };
+}
+
+
+bool
+validate_range_set(const char* flagname, const std::string& value)
+{
+  if (value == "") return true;
+
+  auto [_, ec] = parse_range_set(&*value.cbegin(), &*value.cend());
+  if (ec != std::errc()) {
+    std::cerr << flagname << " does not look like '123-234' or '0-50,10000-10050': " << std::make_error_code(ec) << std::endl;
+    return false;
+  }
+
+  return true;
+}
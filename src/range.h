@@ -1,6 +1,9 @@
 #include <algorithm>
 #include <cstdint>
+#include <limits>
+#include <string>
 #include <system_error>
+#include <vector>
 
 /**
  * A pair of characters on the unsigned-integer number line.
@@ -30,6 +33,57 @@ struct Range {
   }
 };
 
+/**
+ * The rows (within row group `rowGroup`) to read, in order: skip to each
+ * range's start, then read its rows.
+ */
+struct RowGroupPlan {
+  int rowGroup;
+  uint64_t firstRow; // the row group's first row, counting from the start of the file
+  std::vector<Range> rows; // counting from firstRow; sorted, disjoint, non-empty
+};
+
+/**
+ * Several Ranges: say, rows 0-50 and 10000-10050.
+ *
+ * We keep the ranges sorted, and merge ranges that overlap or touch. So a
+ * caller can visit them in order, skipping the gaps between them.
+ */
+class RangeSet {
+  std::vector<Range> ranges; // sorted, disjoint, non-adjacent, non-empty
+
+public:
+  /** Every value. */
+  RangeSet() : ranges { Range() } {}
+
+  /** The values in any of `ranges`. They may overlap, and be in any order. */
+  explicit RangeSet(std::vector<Range> ranges);
+
+  const std::vector<Range>& getRanges() const { return this->ranges; }
+
+  /** Return the number of values. */
+  uint64_t size() const;
+
+  bool includes(uint64_t i) const;
+
+  /** Return the values below `max`. */
+  RangeSet clip(uint64_t max) const;
+
+  /** Return the first `n` values. */
+  RangeSet limit(uint64_t n) const;
+
+  /** Return every value in order: say, column numbers. */
+  std::vector<uint64_t> values() const;
+
+  /**
+   * Split the ranges by row group, given each row group's number of rows.
+   *
+   * Row groups with no rows in the set aren't in the plan: readers can skip
+   * them without opening them.
+   */
+  std::vector<RowGroupPlan> planRowGroups(const std::vector<uint64_t>& rowGroupSizes) const;
+};
+
 struct ParseRangeResult {
   const Range range; // if ec == 0, this is 0-0
   std::errc ec;
@@ -42,3 +96,25 @@ struct ParseRangeResult {
  * std::errc::out_of_range if the range is not valid.
  */
 ParseRangeResult parse_range(const char* begin, const char* end);
+
+struct ParseRangeSetResult {
+  const RangeSet rangeSet; // if ec != 0, this is empty
+  std::errc ec;
+};
+
+/**
+ * Parse a RangeSet from a C string: comma-separated ranges, such as
+ * "0-50,10000-10050".
+ *
+ * Return a result with std::errc::invalid_argument or
+ * std::errc::out_of_range if any range is not valid.
+ */
+ParseRangeSetResult parse_range_set(const char* begin, const char* end);
+
+/**
+ * Validate a RangeSet flag (for DEFINE_validator): "" (meaning all) or a
+ * list parse_range_set() accepts.
+ *
+ * Write an error to stderr and return false if it's invalid.
+ */
+bool validate_range_set(const char* flagname, const std::string& value);
@@ -0,0 +1,31 @@
+#include <cstdint>
+#include <iostream>
+#include <gflags/gflags.h>
+
+#include "common.h"
+#include "reader-flags.h"
+
+
+static bool
+validate_buffer_size(const char* flagname, int64_t value)
+{
+  if (value > 0) return true;
+
+  std::cerr << flagname << " must be positive" << std::endl;
+  return false;
+}
+
+DEFINE_bool(buffered_stream, false, "read column chunks --buffer-size bytes at a time, instead of all at once (less RAM for large chunks, more reads)");
+DEFINE_int64(buffer_size, 16 * 1024, "with --buffered-stream, bytes per read");
+DEFINE_validator(buffer_size, &validate_buffer_size);
+DEFINE_bool(mmap, false, "memory-map the Parquet file, instead of reading it");
+
+
+ReaderOptions readerOptionsFromFlags()
+{
+  return ReaderOptions {
+    .mmap = FLAGS_mmap,
+    .bufferedStream = FLAGS_buffered_stream,
+    .bufferSize = FLAGS_buffer_size,
+  };
+}
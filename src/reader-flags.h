@@ -0,0 +1,7 @@
+struct ReaderOptions; // common.h
+
+/**
+ * Return the ReaderOptions that --mmap, --buffered-stream and --buffer-size
+ * ask for. Every binary links reader-flags.cc, so every binary takes them.
+ */
+ReaderOptions readerOptionsFromFlags();
@@ -0,0 +1,73 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/*
+ * Finding a fixed byte string in longer ones.
+ *
+ * Include utf8.h (or printer.h) first: we use its swar:: helpers.
+ */
+
+
+/**
+ * Finds a needle in haystacks, eight candidate positions at a time.
+ *
+ * We compare the needle's first and last bytes against eight positions per
+ * 64-bit word ("SIMD within a register"), and only memcmp() positions where
+ * both bytes match. Rare bytes make most words come up empty.
+ *
+ * Assumes a little-endian CPU.
+ */
+class SubstringSearcher {
+  std::string needle;
+
+public:
+  explicit SubstringSearcher(std::string_view needle_) : needle(needle_) {}
+
+  size_t size() const { return this->needle.size(); }
+
+  /**
+   * Return the first position in [begin, end) where the needle starts, or
+   * nullptr.
+   *
+   * An empty needle is found at `begin`.
+   */
+  const uint8_t* find(const uint8_t* begin, const uint8_t* end) const {
+    const size_t k = this->needle.size();
+    if (k == 0) return begin;
+    if (static_cast<size_t>(end - begin) < k) return nullptr;
+
+    const uint8_t* needleBytes = reinterpret_cast<const uint8_t*>(this->needle.data());
+    const uint8_t* last = end - k; // last position the needle could start
+    const uint64_t firstBytes = swar::kOnes * needleBytes[0];
+    const uint64_t lastBytes = swar::kOnes * needleBytes[k - 1];
+
+    const uint8_t* p = begin;
+    for (; last - p >= 7; p += 8) {
+      // One high bit per position where first and last bytes both match.
+      // (hasLess() may flag false positives, never false negatives.)
+      uint64_t candidates =
+        swar::hasLess(swar::load(p) ^ firstBytes, 1)
+        & swar::hasLess(swar::load(p + k - 1) ^ lastBytes, 1);
+      while (candidates) {
+        const uint8_t* candidate = p + (__builtin_ctzll(candidates) >> 3);
+        if (std::memcmp(candidate, needleBytes, k) == 0) {
+          return candidate;
+        }
+        candidates &= candidates - 1;
+      }
+    }
+    for (; p <= last; p++) {
+      if (*p == needleBytes[0] && std::memcmp(p, needleBytes, k) == 0) {
+        return p;
+      }
+    }
+    return nullptr;
+  }
+
+  bool contains(std::string_view haystack) const {
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(haystack.data());
+    return this->find(begin, begin + haystack.size()) != nullptr;
+  }
+};
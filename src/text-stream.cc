@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <parquet/api/reader.h>
+#include <parquet/exception.h>
+
+#include "common.h"
+#include "external-sort.h"
+#include "prefetch.h"
+#include "text-stream.h"
+
+
+/*
+ * Sort keys.
+ *
+ * We encode each value so that memcmp() order is value order. That lets
+ * ExternalSorter compare multi-column keys without knowing their types.
+ */
+
+static void appendBigEndian(std::string& key, uint64_t value, int nBytes)
+{
+  for (int shift = (nBytes - 1) * 8; shift >= 0; shift -= 8) {
+    key.push_back(static_cast<char>(value >> shift));
+  }
+}
+
+static void appendSortKey(std::string& key, uint32_t value) { appendBigEndian(key, value, 4); }
+static void appendSortKey(std::string& key, uint64_t value) { appendBigEndian(key, value, 8); }
+static void appendSortKey(std::string& key, int32_t value) { appendBigEndian(key, static_cast<uint32_t>(value) ^ 0x80000000u, 4); }
+static void appendSortKey(std::string& key, int64_t value) { appendBigEndian(key, static_cast<uint64_t>(value) ^ 0x8000000000000000ull, 8); }
+static void appendSortKey(std::string& key, Date value) { appendSortKey(key, value.value); }
+static void appendSortKey(std::string& key, TimestampMillis value) { appendSortKey(key, value.value); }
+static void appendSortKey(std::string& key, TimestampMicros value) { appendSortKey(key, value.value); }
+static void appendSortKey(std::string& key, TimestampNanos value) { appendSortKey(key, value.value); }
+
+static void appendSortKey(std::string& key, float value)
+{
+  // IEEE 754: flip negatives entirely; set positives' sign bit
+  uint32_t bits;
+  std::memcpy(&bits, &value, 4);
+  appendBigEndian(key, (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u), 4);
+}
+
+static void appendSortKey(std::string& key, double value)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &value, 8);
+  appendBigEndian(key, (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull), 8);
+}
+
+static void appendSortKey(std::string& key, std::string_view value)
+{
+  // Escape 0x00 as 0x00 0xFF and end with 0x00 0x00, so no key is a prefix
+  // of another and the next column's key can follow.
+  for (char c : value) {
+    key.push_back(c);
+    if (c == '\0') key.push_back('\xff');
+  }
+  key.push_back('\0');
+  key.push_back('\0');
+}
+
+
+class Transcriber
+{
+public:
+  Transcriber(const Printers& printers_) : printers(printers_) {}
+
+  // https://en.cppreference.com/w/cpp/memory/unique_ptr:
+  // If T is a derived class of some base B, then std::unique_ptr<T> is
+  // implicitly convertible to std::unique_ptr<B>. The default deleter of the
+  // resulting std::unique_ptr<B> will use operator delete for B, leading to
+  // undefined behavior unless the destructor of B is virtual.
+  virtual ~Transcriber() {}
+
+  /**
+   * Skip nRows values.
+   *
+   * Undefined behavior if there are not that many values to skip.
+   */
+  virtual void skipRows(int64_t nRows) = 0;
+
+  /**
+   * Print the next value, to every printer.
+   *
+   * Undefined behavior if there is no next element.
+   */
+  virtual void printNext(size_t outputColumnIndex) = 0;
+
+  /**
+   * Print the header field (CSV-only).
+   */
+  virtual void printHeaderField(size_t outputColumnIndex) = 0;
+
+  /**
+   * Read the next value (without printing it) and append its sort key.
+   *
+   * Nulls sort after all values; `descending` reverses that along with
+   * everything else.
+   *
+   * Undefined behavior if there is no next element.
+   */
+  virtual void appendNextSortKey(std::string& key, bool descending) = 0;
+
+protected:
+  const Printers& printers;
+};
+
+
+template<typename FileColumnIteratorType>
+class BufferedTranscriber : public Transcriber
+{
+public:
+  typedef typename FileColumnIteratorType::PrintableType PrintableType;
+
+private:
+  std::unique_ptr<FileColumnIteratorType> reader;
+
+public:
+  BufferedTranscriber(const Printers& printers, std::unique_ptr<FileColumnIteratorType> reader_)
+    : Transcriber(printers)
+    , reader(std::move(reader_))
+  {
+  }
+
+  void printNext(size_t outputColumnIndex) override
+  {
+    // Decode once, no matter how many formats we're writing
+    std::optional<PrintableType> valueOrNull = this->reader->next();
+    for (const std::unique_ptr<Printer>& printer : this->printers) {
+      printer->writeFieldStart(outputColumnIndex, this->reader->getName());
+      if (valueOrNull.has_value()) {
+        printer->write(valueOrNull.value());
+      } else {
+        printer->writeNull();
+      }
+    }
+  }
+
+  void skipRows(int64_t nRows) override
+  {
+    this->reader->skipRows(nRows);
+  }
+
+  void printHeaderField(size_t outputColumnIndex) override
+  {
+    for (const std::unique_ptr<Printer>& printer : this->printers) {
+      printer->writeHeaderField(outputColumnIndex, this->reader->getName());
+    }
+  }
+
+  void appendNextSortKey(std::string& key, bool descending) override
+  {
+    const size_t start = key.size();
+    std::optional<PrintableType> valueOrNull = this->reader->next();
+    if (valueOrNull.has_value()) {
+      key.push_back('\x01');
+      appendSortKey(key, valueOrNull.value());
+    } else {
+      key.push_back('\x02');
+    }
+    if (descending) {
+      for (size_t i = start; i < key.size(); i++) {
+        key[i] = ~key[i];
+      }
+    }
+  }
+};
+
+template<typename BufferedReaderType>
+static std::unique_ptr<Transcriber>
+makeTranscriber(parquet::ParquetFileReader& fileReader, int columnIndex, const Printers& printers, DictionaryBudget& dictionaryBudget, bool decodePages)
+{
+  typedef FileColumnIterator<BufferedReaderType> FileColumnIteratorType;
+  typedef BufferedTranscriber<FileColumnIteratorType> TranscriberType;
+
+  auto fileColumnIterator = std::make_unique<FileColumnIteratorType>(fileReader, columnIndex, dictionaryBudget, decodePages);
+  auto transcriber = std::make_unique<TranscriberType>(printers, std::move(fileColumnIterator));
+  return std::move(transcriber);
+}
+
+static std::unique_ptr<Transcriber>
+makeTranscriberForColumn(parquet::ParquetFileReader& fileReader, int columnIndex, const Printers& printers, DictionaryBudget& dictionaryBudget, bool decodePages)
+{
+  return visitColumnReaderType(
+    fileReader.metadata()->schema()->Column(columnIndex),
+    [&]<typename BufferedReaderType>() {
+      return makeTranscriber<BufferedReaderType>(fileReader, columnIndex, printers, dictionaryBudget, decodePages);
+    }
+  );
+}
+
+
+
+struct SortColumn {
+  int columnIndex;
+  bool descending;
+};
+
+
+/**
+ * Parse --sort-by: "col1,col2:desc" => [{col1, asc}, {col2, desc}].
+ *
+ * Throw std::runtime_error if a column does not exist.
+ */
+static std::vector<SortColumn>
+parseSortBy(const std::string& value, const parquet::SchemaDescriptor& schema)
+{
+  std::vector<SortColumn> ret;
+  size_t pos = 0;
+  while (pos < value.size()) {
+    size_t comma = value.find(',', pos);
+    if (comma == std::string::npos) comma = value.size();
+    std::string name(value.substr(pos, comma - pos));
+    bool descending = false;
+    if (name.size() > 5 && name.compare(name.size() - 5, 5, ":desc") == 0) {
+      descending = true;
+      name.resize(name.size() - 5);
+    } else if (name.size() > 4 && name.compare(name.size() - 4, 4, ":asc") == 0) {
+      name.resize(name.size() - 4);
+    }
+
+    int columnIndex = schema.ColumnIndex(name);
+    if (columnIndex < 0) {
+      throw std::runtime_error("--sort-by column does not exist: " + name);
+    }
+    ret.push_back(SortColumn { .columnIndex = columnIndex, .descending = descending });
+    pos = comma + 1;
+  }
+  return ret;
+}
+
+
+enum class RecordResult {
+  Written,
+  Full, // --max-bytes: we wrote nothing, and should stop
+  OutputFailed, // e.g., the reader hung up
+};
+
+/**
+ * Write a record to every printer; `writeFields()` writes its fields.
+ *
+ * With --max-bytes, each printer buffers the record and we only commit it if
+ * it fits in every output (along with the file footer). That way every output
+ * stops at the same record boundary.
+ */
+template<typename WriteFields>
+static RecordResult
+writeRecord(const Printers& printers, int64_t maxBytes, const std::vector<size_t>& footerSizes, int outputRowIndex, WriteFields writeFields)
+{
+  for (const std::unique_ptr<Printer>& printer : printers) {
+    printer->writeRecordStart(outputRowIndex);
+  }
+  writeFields();
+  for (const std::unique_ptr<Printer>& printer : printers) {
+    printer->writeRecordStop();
+  }
+
+  if (maxBytes >= 0) {
+    bool fits = true;
+    for (size_t i = 0; i < printers.size(); i++) {
+      Printer& printer = *printers[i];
+      if (printer.bytesWritten() + static_cast<int64_t>(printer.bufferedSize() + footerSizes[i]) > maxBytes) {
+        fits = false;
+      }
+    }
+    if (!fits) {
+      for (const std::unique_ptr<Printer>& printer : printers) {
+        printer->discardBuffer();
+      }
+      return RecordResult::Full;
+    }
+  }
+  for (const std::unique_ptr<Printer>& printer : printers) {
+    printer->commitBuffer(); // no-op if we aren't buffering records
+  }
+
+  for (const std::unique_ptr<Printer>& printer : printers) {
+    if (printer->failed()) {
+      return RecordResult::OutputFailed;
+    }
+  }
+  return RecordResult::Written;
+}
+
+
+StreamResult
+streamParquet(const std::string& path, const Printers& printers, const StreamOptions& options) {
+  // A buffered stream reads each chunk in small pieces: prefetching whole
+  // chunks would read everything twice
+  std::shared_ptr<PrefetchingFile> file;
+  std::unique_ptr<parquet::ParquetFileReader> fileReader;
+  try {
+    file = std::make_shared<PrefetchingFile>(
+      openParquetInput(path, options.reader),
+      options.reader.bufferedStream ? 0 : options.prefetchRowGroups,
+      options.prefetchBytes
+    );
+    fileReader = openParquet(file, options.reader);
+  } catch (const parquet::ParquetException& ex) {
+    throw std::runtime_error(std::string("Failure opening Parquet file: ") + ex.what());
+  }
+
+  const parquet::FileMetaData& metadata = *fileReader->metadata();
+  const std::vector<SortColumn> sortColumns(parseSortBy(options.sortBy, *metadata.schema()));
+
+  const std::vector<uint64_t> columnIndexes(options.columns.clip(metadata.num_columns()).values());
+  RangeSet rowSet(options.rows.clip(metadata.num_rows()));
+  uint64_t maxRows = options.maxRows >= 0 ? options.maxRows : rowSet.size();
+  if (sortColumns.empty()) {
+    rowSet = rowSet.limit(maxRows); // when sorting, we must read every row
+  }
+
+  std::vector<uint64_t> rowGroupSizes;
+  for (int i = 0; i < metadata.num_row_groups(); i++) {
+    rowGroupSizes.push_back(metadata.RowGroup(i)->num_rows());
+  }
+  std::vector<int> rowGroups;
+  std::vector<Range> rowRanges; // counting from the start of the file
+  for (const RowGroupPlan& plan : rowSet.planRowGroups(rowGroupSizes)) {
+    rowGroups.push_back(plan.rowGroup);
+    for (const Range& rows : plan.rows) {
+      rowRanges.push_back(Range(plan.firstRow + rows.start, plan.firstRow + rows.stop));
+    }
+  }
+
+  std::vector<int> prefetchColumns(columnIndexes.begin(), columnIndexes.end());
+  for (const SortColumn& sortColumn : sortColumns) {
+    prefetchColumns.push_back(sortColumn.columnIndex);
+  }
+  std::sort(prefetchColumns.begin(), prefetchColumns.end());
+  prefetchColumns.erase(std::unique(prefetchColumns.begin(), prefetchColumns.end()), prefetchColumns.end());
+  file->start(metadata, rowGroups, prefetchColumns);
+
+  DictionaryBudget dictionaryBudget(options.dictionaryMemory);
+  std::vector<std::unique_ptr<Transcriber>> transcribers(columnIndexes.size());
+  for (size_t i = 0; i < transcribers.size(); i++) {
+    transcribers[i] = makeTranscriberForColumn(*fileReader, columnIndexes[i], printers, dictionaryBudget, options.decodePages);
+  }
+
+  // Sort-key columns get their own readers (that print nothing)
+  const Printers noPrinters;
+  std::vector<std::unique_ptr<Transcriber>> sortKeyReaders(sortColumns.size());
+  for (size_t i = 0; i < sortColumns.size(); i++) {
+    sortKeyReaders[i] = makeTranscriberForColumn(*fileReader, sortColumns[i].columnIndex, noPrinters, dictionaryBudget, options.decodePages);
+  }
+
+  // Move every reader to row `row`, skipping the rows in between
+  int64_t nextRow = 0;
+  auto skipTo = [&](int64_t row) {
+    for (const std::unique_ptr<Transcriber>& transcriber : transcribers) {
+      transcriber->skipRows(row - nextRow);
+    }
+    for (const std::unique_ptr<Transcriber>& sortKeyReader : sortKeyReaders) {
+      sortKeyReader->skipRows(row - nextRow);
+    }
+    nextRow = row;
+  };
+
+  // With --max-bytes, we buffer each record and only write it if it fits
+  // along with the file footer. Measure the footer now.
+  std::vector<size_t> footerSizes(printers.size(), 0);
+  if (options.maxBytes >= 0) {
+    for (size_t i = 0; i < printers.size(); i++) {
+      printers[i]->writeFileFooter();
+      footerSizes[i] = printers[i]->bufferedSize();
+      printers[i]->discardBuffer();
+    }
+  }
+
+  // Write headers
+  for (const std::unique_ptr<Printer>& printer : printers) {
+    printer->writeFileHeader();
+  }
+  if (transcribers.size() > 0) {
+    // Track where we are, so we can report invalid UTF-8 (-1 => header)
+    int64_t rowIndex = -1;
+    size_t outputColumnIndex = 0;
+    RecordResult result = RecordResult::Written;
+    try {
+      // Write headers
+      for (outputColumnIndex = 0; outputColumnIndex < transcribers.size(); outputColumnIndex++) {
+        transcribers[outputColumnIndex]->printHeaderField(outputColumnIndex);
+      }
+      for (const std::unique_ptr<Printer>& printer : printers) {
+        printer->commitBuffer(); // headers are written even if they exceed --max-bytes
+      }
+
+      if (sortColumns.empty()) {
+        // Write rows
+        int64_t outputRowIndex = 0;
+        for (const Range& rows : rowRanges) {
+          skipTo(rows.start);
+          for (rowIndex = rows.start; rowIndex < static_cast<int64_t>(rows.stop); rowIndex++) {
+            result = writeRecord(printers, options.maxBytes, footerSizes, outputRowIndex++, [&]() {
+              for (outputColumnIndex = 0; outputColumnIndex < transcribers.size(); outputColumnIndex++) {
+                transcribers[outputColumnIndex]->printNext(outputColumnIndex);
+              }
+            });
+            if (result != RecordResult::Written) break;
+          }
+          if (result != RecordResult::Written) break;
+          nextRow = rows.stop;
+        }
+      } else {
+        // Read rows: key => each printer's formatted fields
+        ExternalSorter sorter(options.sortMemory);
+        std::string key;
+        std::string fields;
+        for (const Range& rows : rowRanges) {
+          skipTo(rows.start);
+          for (rowIndex = rows.start; rowIndex < static_cast<int64_t>(rows.stop); rowIndex++) {
+            key.clear();
+            for (size_t i = 0; i < sortColumns.size(); i++) {
+              sortKeyReaders[i]->appendNextSortKey(key, sortColumns[i].descending);
+            }
+            appendBigEndian(key, rowIndex, 8); // stable sort
+
+            for (outputColumnIndex = 0; outputColumnIndex < transcribers.size(); outputColumnIndex++) {
+              transcribers[outputColumnIndex]->printNext(outputColumnIndex);
+            }
+            fields.clear();
+            for (const std::unique_ptr<Printer>& printer : printers) {
+              std::string_view bytes(printer->bufferedBytes());
+              appendBigEndian(fields, bytes.size(), 4);
+              fields.append(bytes);
+              printer->discardBuffer();
+            }
+            sorter.add(key, fields);
+          }
+          nextRow = rows.stop;
+        }
+        rowIndex = -1;
+        sortKeyReaders.clear(); // release their dictionaries
+        transcribers.clear();
+        sorter.finish();
+
+        // Write rows, sorted
+        std::string_view sortedFields;
+        for (uint64_t outputRowIndex = 0; outputRowIndex < maxRows && sorter.next(&sortedFields); outputRowIndex++) {
+          result = writeRecord(printers, options.maxBytes, footerSizes, outputRowIndex, [&]() {
+            const char* p = sortedFields.data();
+            for (const std::unique_ptr<Printer>& printer : printers) {
+              const uint8_t* sizeBytes = reinterpret_cast<const uint8_t*>(p);
+              const size_t size = (sizeBytes[0] << 24) | (sizeBytes[1] << 16) | (sizeBytes[2] << 8) | sizeBytes[3];
+              printer->writeRaw(std::string_view(p + 4, size));
+              p += 4 + size;
+            }
+          });
+          if (result != RecordResult::Written) break;
+        }
+      }
+    } catch (const InvalidUtf8Error& err) {
+      for (const std::unique_ptr<Printer>& printer : printers) {
+        printer->flush();
+      }
+      const size_t columnIndex = columnIndexes[outputColumnIndex];
+      const std::string name(fileReader->metadata()->schema()->Column(columnIndex)->name());
+      if (rowIndex < 0) {
+        throw std::runtime_error("Invalid UTF-8 in name of column " + std::to_string(columnIndex));
+      } else {
+        throw std::runtime_error("Invalid UTF-8 in row " + std::to_string(rowIndex) + ", column " + std::to_string(columnIndex) + " (" + name + ")");
+      }
+    }
+
+    if (result == RecordResult::OutputFailed) {
+      return StreamResult { .outputFailed = true }; // stop decoding; the destructors release our readers
+    }
+  }
+  for (const std::unique_ptr<Printer>& printer : printers) {
+    printer->writeFileFooter();
+    printer->flush();
+    if (printer->failed()) {
+      return StreamResult { .outputFailed = true };
+    }
+  }
+
+  return StreamResult {
+    .outputFailed = false,
+    .peakDictionaryHeapBytes = dictionaryBudget.peakHeapBytes(),
+    .peakDictionarySpilledBytes = dictionaryBudget.peakSpilledBytes(),
+  };
+}
+
+
+std::unique_ptr<Printer>
+makePrinter(const std::string& format, FILE* fp, const StreamOptions& options)
+{
+  // --max-bytes must measure records; --sort-by must capture them
+  const bool bufferRecords = options.maxBytes >= 0 || options.sortBy != "";
+  if (format == "csv") {
+    return std::make_unique<CsvPrinter>(fp, options.utf8Validation, bufferRecords);
+  } else if (format == "json") {
+    return std::make_unique<JsonPrinter>(fp, options.utf8Validation, bufferRecords);
+  } else {
+    throw std::runtime_error("<FORMAT> must be either 'csv' or 'json'");
+  }
+}
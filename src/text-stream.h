@@ -0,0 +1,68 @@
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "column-iterator.h"
+#include "printer.h"
+#include "range.h"
+
+/*
+ * Writing a Parquet file as CSV or JSON, as parquet-to-text-stream does.
+ *
+ * Include common.h first: StreamOptions holds its ReaderOptions.
+ */
+
+/**
+ * What to write: parquet-to-text-stream's flags.
+ */
+struct StreamOptions {
+  RangeSet columns; // column numbers to write (default all)
+  RangeSet rows; // row numbers to write (default all)
+  int64_t maxRows = -1; // stop after writing this many rows (-1 for no limit)
+  int64_t maxBytes = -1; // stop before the record that would make an output exceed this many bytes (-1 for no limit)
+  std::string sortBy; // "col1,col2:desc": sort rows by these columns ("" to keep file order)
+  int64_t sortMemory = 256 * 1024 * 1024; // bytes of formatted rows to sort in RAM; more spill to temporary files
+  int64_t dictionaryMemory = 256 * 1024 * 1024; // bytes of dictionaries to hold in RAM; more spill (-1 for no limit)
+  int prefetchRowGroups = 1; // row groups to read ahead in the background (0 to disable)
+  int64_t prefetchBytes = 64 * 1024 * 1024; // read-ahead bytes to hold in memory
+  bool decodePages = true; // decode pages directly, bypassing parquet::ColumnReader
+  Utf8Validation utf8Validation = Utf8Validation::None;
+  ReaderOptions reader;
+};
+
+struct StreamResult {
+  bool outputFailed; // we stopped early because an output failed (e.g., the reader hung up)
+  int64_t peakDictionaryHeapBytes;
+  int64_t peakDictionarySpilledBytes;
+};
+
+/**
+ * Return a Printer that writes `format` ("csv" or "json") to `fp`. It
+ * buffers records if `options` need that: maxBytes measures them, and sortBy
+ * captures them.
+ *
+ * Throw std::runtime_error if `format` is neither.
+ */
+std::unique_ptr<Printer> makePrinter(const std::string& format, FILE* fp, const StreamOptions& options);
+
+/**
+ * Write the rows in `options.rows` to every printer (each from
+ * makePrinter()), with the columns in `options.columns`.
+ *
+ * We open the file and parse its footer once, however many ranges there are.
+ * RangeSet::planRowGroups() says which row groups hold rows in the set: we
+ * prefetch only those, and skip the rows between ranges without decoding
+ * them (and row groups between ranges without opening them).
+ *
+ * With `options.sortBy`, we read every row first: we format each row's
+ * fields into an ExternalSorter (which spills to disk beyond
+ * `options.sortMemory`), keyed by the sort columns; then we write the rows in
+ * sorted order. Printers must be buffering records, so we can capture the
+ * fields.
+ *
+ * Throw std::runtime_error if we can't open the file, a sort column doesn't
+ * exist or (with Utf8Validation::Error) a string isn't UTF-8. Printers hold
+ * what we wrote before the error, flushed.
+ */
+StreamResult streamParquet(const std::string& path, const Printers& printers, const StreamOptions& options);
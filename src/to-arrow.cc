@@ -0,0 +1,58 @@
+#include <memory>
+#include <string>
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/api/reader.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/exception.h>
+
+#include "common.h"
+#include "to-arrow.h"
+
+
+static std::shared_ptr<arrow::Table> readParquet(const std::string& path, const ReaderOptions& readerOptions) {
+  std::unique_ptr<parquet::ParquetFileReader> parquetFileReader(openParquet(path, readerOptions));
+  parquet::ArrowReaderProperties arrowReaderProperties(false); // do not use threads
+
+  // Decide which columns to read as dictionary
+  // (Arrow seems good at interpreting its _own_ written parquet dictionaries;
+  // but not fastparquet-written dictionaries. Maybe because encoding=4 is
+  // missing? [adamhooper, 2019-10-09] I can't figure it out.)
+  if (parquetFileReader->metadata()->num_row_groups() > 0) {
+    std::shared_ptr<parquet::RowGroupReader> rowGroupReader(parquetFileReader->RowGroup(0));
+    const parquet::RowGroupMetaData* rowGroupMetaData(rowGroupReader->metadata());
+
+    for (int i = 0; i < rowGroupMetaData->num_columns(); i++) {
+      const std::unique_ptr<parquet::ColumnChunkMetaData> columnMetaData(rowGroupMetaData->ColumnChunk(i));
+      arrowReaderProperties.set_read_dictionary(i, columnMetaData->has_dictionary_page());
+    }
+  }
+
+  std::unique_ptr<parquet::arrow::FileReader> parquetArrowReader;
+  THROW_UNLESS_ARROW_OK(parquet::arrow::FileReader::Make(arrow::default_memory_pool(), std::move(parquetFileReader), arrowReaderProperties, &parquetArrowReader), "creating Parquet reader");
+
+  std::shared_ptr<arrow::Schema> schema;
+  THROW_UNLESS_ARROW_OK(parquetArrowReader->GetSchema(&schema), "converting to Arrow schema");
+  // Clear metadata. (If we're reading from fastparquet there's nonsense
+  // metadata in the Parquet file.)
+  schema = schema->RemoveMetadata();
+
+  // Output a single-record-batch array: read a column at a time
+  std::vector<std::shared_ptr<arrow::Array>> arrays;
+
+  for (int i = 0; i < schema->num_fields(); i++) {
+    std::shared_ptr<arrow::ChunkedArray> chunkedArray;
+    THROW_UNLESS_ARROW_OK(parquetArrowReader->ReadColumn(i, &chunkedArray), "reading column");
+    std::shared_ptr<arrow::Array> columnArray = chunkedArrayToArray(*chunkedArray);
+    arrays.push_back(columnArray);
+  }
+
+  return arrow::Table::Make(schema, arrays);
+}
+
+
+void convertParquetToArrow(const std::string& parquetPath, const std::string& arrowPath, const ReaderOptions& readerOptions)
+{
+  std::shared_ptr<arrow::Table> arrowTable(readParquet(parquetPath, readerOptions));
+  writeArrowTable(*arrowTable, arrowPath);
+}
@@ -0,0 +1,16 @@
+#include <string>
+
+/*
+ * Converting a Parquet file to Arrow, as parquet-to-arrow does.
+ *
+ * Include common.h first: we take its ReaderOptions.
+ */
+
+/**
+ * Read a Parquet file and write it as an Arrow IPC file with one record
+ * batch, reading dictionary-encoded columns as Arrow dictionaries.
+ *
+ * Throw parquet::ParquetException if the Parquet file is invalid, or
+ * std::runtime_error if Arrow can't convert or write it.
+ */
+void convertParquetToArrow(const std::string& parquetPath, const std::string& arrowPath, const ReaderOptions& readerOptions);
@@ -0,0 +1,149 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+/*
+ * UTF-8 validation, for printers that escape strings.
+ *
+ * Parquet STRING columns are supposed to be UTF-8, but nothing stops a writer
+ * from storing arbitrary bytes. Printers call these helpers from their escape
+ * loops, so validating costs one extra branch per non-ASCII byte.
+ *
+ * The scans test 8 bytes at a time with SWAR (SIMD-within-a-register) tricks:
+ * plain 64-bit arithmetic, so our static binaries run on any CPU.
+ */
+
+
+enum class Utf8Validation {
+  None, // assume valid: copy bytes as-is
+  Error, // throw InvalidUtf8Error
+  Replace, // write U+FFFD REPLACEMENT CHARACTER for each invalid subsequence
+};
+
+
+static const char kUtf8ReplacementCharacter[] = "\xEF\xBF\xBD";
+
+
+struct InvalidUtf8Error : public std::runtime_error {
+  InvalidUtf8Error() : std::runtime_error("invalid UTF-8") {}
+};
+
+
+namespace swar {
+
+static constexpr uint64_t kOnes = 0x0101010101010101ULL;
+static constexpr uint64_t kHighBits = 0x8080808080808080ULL;
+
+static inline uint64_t load(const uint8_t* p)
+{
+  uint64_t word;
+  std::memcpy(&word, p, 8);
+  return word;
+}
+
+/** Nonzero iff some byte of `word` is < n. (n <= 128.) */
+static inline uint64_t hasLess(uint64_t word, uint8_t n)
+{
+  return (word - kOnes * n) & ~word & kHighBits;
+}
+
+/** Nonzero iff some byte of `word` is `b`. */
+static inline uint64_t hasByte(uint64_t word, uint8_t b)
+{
+  return hasLess(word ^ (kOnes * b), 1);
+}
+
+} // namespace swar
+
+
+/**
+ * Measure the possibly-incomplete UTF-8 sequence at `p`.
+ *
+ * `*p` must be a non-ASCII byte. Set `*length` to the length its lead byte
+ * announces (0 if it isn't a valid lead byte), and return how many bytes,
+ * starting at `p`, are a valid prefix of such a sequence.
+ *
+ * Follows Unicode Table 3-7: no overlong forms, no surrogates, nothing past
+ * U+10FFFF.
+ */
+static inline int utf8ValidPrefix(const uint8_t* p, const uint8_t* end, int* length)
+{
+  const uint8_t lead = p[0];
+  uint8_t lo = 0x80;
+  uint8_t hi = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    *length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    *length = 3;
+    if (lead == 0xE0) lo = 0xA0; // overlong
+    if (lead == 0xED) hi = 0x9F; // surrogate
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    *length = 4;
+    if (lead == 0xF0) lo = 0x90; // overlong
+    if (lead == 0xF4) hi = 0x8F; // > U+10FFFF
+  } else {
+    *length = 0;
+    return 0;
+  }
+
+  int i = 1;
+  for (; i < *length && p + i < end; i++) {
+    if (p[i] < lo || p[i] > hi) break;
+    lo = 0x80;
+    hi = 0xBF;
+  }
+  return i;
+}
+
+
+/**
+ * Return the length of the valid non-ASCII UTF-8 sequence at `p`, or 0.
+ */
+static inline int utf8SequenceLength(const uint8_t* p, const uint8_t* end)
+{
+  int length;
+  int prefix = utf8ValidPrefix(p, end, &length);
+  return prefix == length ? length : 0;
+}
+
+
+/**
+ * Return the length of the invalid sequence at `p`.
+ *
+ * This is the "maximal subpart": a truncated-but-otherwise-valid sequence
+ * counts as one error, and so does a lone invalid byte. Replacing each with
+ * one U+FFFD is what the Unicode Standard (and WHATWG) recommend.
+ */
+static inline int utf8InvalidLength(const uint8_t* p, const uint8_t* end)
+{
+  int length;
+  int prefix = utf8ValidPrefix(p, end, &length);
+  return prefix > 0 ? prefix : 1;
+}
+
+
+/**
+ * Return `value` with each invalid UTF-8 subsequence replaced by U+FFFD.
+ */
+static inline std::string utf8Replace(std::string_view value)
+{
+  std::string ret;
+  ret.reserve(value.size() + 3);
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(value.data());
+  const uint8_t* end = p + value.size();
+  while (p < end) {
+    if (*p < 0x80) {
+      ret.push_back(static_cast<char>(*p));
+      p++;
+    } else if (int n = utf8SequenceLength(p, end)) {
+      ret.append(reinterpret_cast<const char*>(p), n);
+      p += n;
+    } else {
+      ret.append(kUtf8ReplacementCharacter, 3);
+      p += utf8InvalidLength(p, end);
+    }
+  }
+  return ret;
+}
@@ -0,0 +1,259 @@
+import ctypes
+import json
+import subprocess
+from pathlib import Path
+
+import pyarrow
+import pyarrow.ipc
+
+from .util import arrow_file, empty_file, parquet_file
+
+LIB = ctypes.CDLL("/usr/lib/libparquet-tools.so")
+
+WRITE_FN = ctypes.CFUNCTYPE(
+    ctypes.c_int, ctypes.c_void_p, ctypes.POINTER(ctypes.c_char), ctypes.c_size_t
+)
+
+
+class ReaderOptions(ctypes.Structure):
+    _fields_ = [
+        ("mmap", ctypes.c_int),
+        ("buffered_stream", ctypes.c_int),
+        ("buffer_size", ctypes.c_int64),
+    ]
+
+
+class StreamOptions(ctypes.Structure):
+    _fields_ = [
+        ("format", ctypes.c_char_p),
+        ("column_range", ctypes.c_char_p),
+        ("row_range", ctypes.c_char_p),
+        ("max_rows", ctypes.c_int64),
+        ("max_bytes", ctypes.c_int64),
+        ("sort_by", ctypes.c_char_p),
+        ("sort_memory", ctypes.c_int64),
+        ("dictionary_memory", ctypes.c_int64),
+        ("prefetch_row_groups", ctypes.c_int32),
+        ("prefetch_bytes", ctypes.c_int64),
+        ("validate_utf8", ctypes.c_char_p),
+        ("reader", ReaderOptions),
+        ("write", WRITE_FN),
+        ("user_data", ctypes.c_void_p),
+    ]
+
+
+class DiffOptions(ctypes.Structure):
+    _fields_ = [
+        ("threads", ctypes.c_int32),
+        ("max_differences", ctypes.c_int64),
+        ("summary", ctypes.c_int),
+        ("loose_row_groups", ctypes.c_int),
+        ("key", ctypes.c_char_p),
+        ("key_memory", ctypes.c_int64),
+        ("columns", ctypes.c_char_p),
+        ("row_range", ctypes.c_char_p),
+        ("arrow", ctypes.c_int),
+        ("reader", ReaderOptions),
+        ("write", WRITE_FN),
+        ("user_data", ctypes.c_void_p),
+    ]
+
+
+ERROR_ARGS = [ctypes.POINTER(ctypes.c_char), ctypes.c_size_t]
+LIB.parquet_tools_to_arrow.argtypes = [
+    ctypes.c_char_p,
+    ctypes.c_char_p,
+    ctypes.POINTER(ReaderOptions),
+    *ERROR_ARGS,
+]
+LIB.parquet_tools_stream.argtypes = [
+    ctypes.c_char_p,
+    ctypes.POINTER(StreamOptions),
+    *ERROR_ARGS,
+]
+LIB.parquet_tools_diff.argtypes = [
+    ctypes.c_char_p,
+    ctypes.c_char_p,
+    ctypes.POINTER(DiffOptions),
+    *ERROR_ARGS,
+]
+
+
+def _call_with_output(fn, options, *args, stop_after=None):
+    """
+    Call `fn(*args, byref(options), error, sizeof(error))`, collecting output.
+
+    Return (return code, output bytes, error message).
+    """
+    chunks = []
+
+    def write(user_data, data, size):
+        chunks.append(ctypes.string_at(data, size))
+        return 1 if stop_after is not None and len(chunks) >= stop_after else 0
+
+    options.write = WRITE_FN(write)  # keep a reference until fn returns
+    error = ctypes.create_string_buffer(1000)
+    code = fn(*args, ctypes.byref(options), error, ctypes.sizeof(error))
+    return code, b"".join(chunks), error.value.decode("utf-8")
+
+
+def do_stream(parquet_path: Path, stop_after=None, **kwargs):
+    options = StreamOptions()
+    LIB.parquet_tools_stream_options_init(ctypes.byref(options))
+    for k, v in kwargs.items():
+        setattr(options, k, v)
+    return _call_with_output(
+        LIB.parquet_tools_stream,
+        options,
+        str(parquet_path).encode("utf-8"),
+        stop_after=stop_after,
+    )
+
+
+def do_diff(path1: Path, path2: Path, **kwargs):
+    options = DiffOptions()
+    LIB.parquet_tools_diff_options_init(ctypes.byref(options))
+    for k, v in kwargs.items():
+        setattr(options, k, v)
+    return _call_with_output(
+        LIB.parquet_tools_diff,
+        options,
+        str(path1).encode("utf-8"),
+        str(path2).encode("utf-8"),
+    )
+
+
+TABLE = pyarrow.table(
+    {
+        "i": list(range(10)),
+        "s": ["value %d" % i for i in range(10)],
+    }
+)
+
+
+def test_stream_matches_binary():
+    with parquet_file(TABLE, use_dictionary=True, chunk_size=3) as parquet_path:
+        for format in ("csv", "json"):
+            expected = subprocess.run(
+                ["/usr/bin/parquet-to-text-stream", str(parquet_path), format],
+                capture_output=True,
+                check=True,
+            ).stdout
+            code, output, error = do_stream(parquet_path, format=format.encode())
+            assert (code, output, error) == (0, expected, "")
+
+
+def test_stream_options():
+    with parquet_file(TABLE, chunk_size=3) as parquet_path:
+        code, output, error = do_stream(
+            parquet_path,
+            column_range=b"1-2",
+            row_range=b"2-4,8-10",
+            sort_by=b"i:desc",
+            max_rows=3,
+            sort_memory=1,
+            dictionary_memory=0,
+            reader=ReaderOptions(mmap=1, buffered_stream=1, buffer_size=100),
+        )
+    assert (code, error) == (0, "")
+    assert json.loads(output) == [
+        {"s": "value 9"},
+        {"s": "value 8"},
+        {"s": "value 3"},
+    ]
+
+
+def test_stream_write_stops():
+    values = ["value %d" % i for i in range(100000)]
+    with parquet_file(pyarrow.table({"s": values})) as parquet_path:
+        code, output, error = do_stream(parquet_path, stop_after=1)
+    assert (code, error) == (141, "")
+    assert 0 < len(output) < 100000
+
+
+def test_stream_error():
+    with empty_file() as path:
+        code, output, error = do_stream(path)
+    assert code == 1
+    assert error.startswith("Failure opening Parquet file: ")
+
+    with parquet_file(TABLE) as parquet_path:
+        assert do_stream(parquet_path, row_range=b"x") == (
+            1,
+            b"",
+            "row_range does not look like '123-234' or '0-50,10000-10050': Invalid argument",
+        )
+        assert do_stream(parquet_path, sort_by=b"nope") == (
+            1,
+            b"",
+            "--sort-by column does not exist: nope",
+        )
+
+
+def test_stream_unsupported_column_error():
+    # An error deep in the reader must come back as an error, not abort us
+    table = pyarrow.table({"t": pyarrow.array([1, 2], pyarrow.time32("s"))})
+    with parquet_file(table) as parquet_path:
+        code, output, error = do_stream(parquet_path)
+    assert code == 1
+    assert error.startswith("For INT32 and INT64, we only handle INT and TIMESTAMP types")
+
+
+def test_diff():
+    table2 = pyarrow.table({"i": list(range(10)), "s": ["value 0"] * 10})
+    with parquet_file(TABLE) as path1, parquet_file(table2) as path2:
+        assert do_diff(path1, path1) == (0, b"", "")
+        expected = subprocess.run(
+            ["/usr/bin/parquet-diff", "--max-differences=3", str(path1), str(path2)],
+            capture_output=True,
+        ).stdout
+        assert do_diff(path1, path2, max_differences=3) == (1, expected, "")
+        assert do_diff(path1, path2, key=b"nope") == (
+            2,
+            b"",
+            "--key column does not exist: nope",
+        )
+
+
+def test_diff_arrow():
+    with parquet_file(TABLE) as path1, arrow_file(TABLE) as path2:
+        assert do_diff(path1, path2, arrow=1) == (0, b"", "")
+
+
+def test_diff_invalid_file():
+    with parquet_file(TABLE) as path1, empty_file() as path2:
+        code, output, error = do_diff(path1, path2)
+    assert (code, output) == (2, b"")
+    assert error != ""
+
+
+def test_to_arrow():
+    with parquet_file(TABLE, use_dictionary=True) as parquet_path, empty_file() as (
+        arrow_path
+    ):
+        error = ctypes.create_string_buffer(1000)
+        code = LIB.parquet_tools_to_arrow(
+            str(parquet_path).encode("utf-8"),
+            str(arrow_path).encode("utf-8"),
+            None,
+            error,
+            ctypes.sizeof(error),
+        )
+        assert (code, error.value) == (0, b"")
+        result = pyarrow.ipc.open_file(str(arrow_path)).read_all()
+    assert result.to_pydict() == TABLE.to_pydict()
+    assert pyarrow.types.is_dictionary(result.schema.field("s").type)
+
+
+def test_to_arrow_error():
+    with empty_file() as parquet_path, empty_file() as arrow_path:
+        error = ctypes.create_string_buffer(10)
+        code = LIB.parquet_tools_to_arrow(
+            str(parquet_path).encode("utf-8"),
+            str(arrow_path).encode("utf-8"),
+            None,
+            error,
+            ctypes.sizeof(error),
+        )
+    assert code == 1
+    assert len(error.value) == 9  # truncated, with a NUL
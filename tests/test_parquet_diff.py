@@ -4,13 +4,14 @@ from pathlib import Path
 from typing import Tuple
 
 import pyarrow
+import pyarrow.parquet
 
-from .util import empty_file, parquet_file
+from .util import arrow_file, empty_file, parquet_file
 
 
-def do_diff(path1: Path, path2: Path) -> Tuple[int, str]:
+def do_diff(path1: Path, path2: Path, *args: str) -> Tuple[int, str]:
     completed = subprocess.run(
-        ["/usr/bin/parquet-diff", str(path1), str(path2)],
+        ["/usr/bin/parquet-diff", *args, str(path1), str(path2)],
         capture_output=True,
         encoding="utf-8",
         errors="replace",
@@ -362,3 +363,711 @@ def test_diff_in_non_first_column():
         1,
         "RowGroup 0, Column 1, Row 1:\n-3\n+1\n",
     )
+
+
+def test_parallel_reports_first_difference():
+    values = list(range(1000))
+    table1 = pyarrow.table({"A": values, "B": values, "C": values})
+    table2 = pyarrow.table(
+        {
+            "A": values[:900] + [-1] + values[901:],  # row group 9
+            "B": values[:150] + [-2] + values[151:],  # row group 1
+            "C": values[:120] + [-3] + values[121:],  # row group 1, later column
+        }
+    )
+    with parquet_file(table1, row_group_size=100) as parquet1:
+        with parquet_file(table2, row_group_size=100) as parquet2:
+            for threads in ("1", "4", "16"):
+                assert do_diff(parquet1, parquet2, "--threads", threads) == (
+                    1,
+                    "RowGroup 1, Column 1, Row 50:\n-150\n+-2\n",
+                )
+
+
+def test_parallel_reports_value_before_later_row_group_size():
+    table1 = pyarrow.table({"A": [1, 2, 3, 4]})
+    table2 = pyarrow.table({"A": [1, 5, 3]})
+    with parquet_file(table1, row_group_size=2) as parquet1:
+        with parquet_file(table2, row_group_size=2) as parquet2:
+            assert do_diff(parquet1, parquet2, "--threads", "4") == (
+                1,
+                "RowGroup 0, Column 0, Row 1:\n-2\n+5\n",
+            )
+
+
+def test_same_size_chunks_with_different_bytes():
+    # Same codec, encodings and sizes: only the bytes tell them apart
+    table1 = pyarrow.table({"A": [1, 2, 3], "B": ["x", "y", "z"]})
+    table2 = pyarrow.table({"A": [1, 2, 3], "B": ["x", "q", "z"]})
+    with parquet_file(table1) as parquet1:
+        with parquet_file(table2) as parquet2:
+            assert do_diff(parquet1, parquet2) == (
+                1,
+                "RowGroup 0, Column 1, Row 1:\n-y\n+q\n",
+            )
+
+
+def test_statistics_hint_does_not_change_first_difference():
+    # Row group 0 differs with equal statistics (two values swap places);
+    # row group 1 differs with different statistics. Report row group 0.
+    table1 = pyarrow.table({"A": [1, 2, 3, 4, 5, 6]})
+    table2 = pyarrow.table({"A": [2, 1, 3, 4, 5, 60]})
+    with parquet_file(table1, row_group_size=3) as parquet1:
+        with parquet_file(table2, row_group_size=3) as parquet2:
+            for threads in ("1", "4"):
+                assert do_diff(parquet1, parquet2, "--threads", threads) == (
+                    1,
+                    "RowGroup 0, Column 0, Row 0:\n-1\n+2\n",
+                )
+
+
+def test_float_nan_equals_same_nan():
+    table = pyarrow.table({"A": pyarrow.array([1.0, float("nan"), None])})
+    assert arrow_table_diff(table, table) == (0, "")
+
+
+def test_float_negative_zero_equals_zero():
+    table1 = pyarrow.table({"A": pyarrow.array([1.0, 0.0], pyarrow.float64())})
+    table2 = pyarrow.table({"A": pyarrow.array([1.0, -0.0], pyarrow.float64())})
+    assert arrow_table_diff(table1, table2) == (0, "")
+
+
+def test_difference_after_many_equal_values():
+    values1 = [None if i % 7 == 0 else i for i in range(10000)]
+    values2 = list(values1)
+    values2[9001] = None
+    assert arrow_table_diff(
+        pyarrow.table({"A": values1}), pyarrow.table({"A": values2})
+    ) == (1, "RowGroup 0, Column 0, Row 9001:\n-9001\n+(null)\n")
+
+
+def test_max_differences():
+    # Nulls and values interleave, across row groups and columns
+    table1 = pyarrow.table({"A": [1, 2, None, 4, 5, 6], "B": ["a", "b", "c", "d", "e", "f"]})
+    table2 = pyarrow.table({"A": [1, 20, 3, 4, 50, 6], "B": ["a", "b", "c", "D", "e", "f"]})
+    with parquet_file(table1, row_group_size=3) as parquet1:
+        with parquet_file(table2, row_group_size=3) as parquet2:
+            for threads in ("1", "4"):
+                assert do_diff(
+                    parquet1, parquet2, "--max-differences=3", "--threads", threads
+                ) == (
+                    1,
+                    "RowGroup 0, Column 0, Row 1:\n-2\n+20\n"
+                    "RowGroup 0, Column 0, Row 2:\n-(null)\n+3\n"
+                    "RowGroup 1, Column 0, Row 1:\n-5\n+50\n",
+                )
+
+
+def test_summary():
+    table1 = pyarrow.table({"A": [1, 2, None, 4, 5, 6], "B": ["a", "b", "c", "d", "e", "f"]})
+    table2 = pyarrow.table({"A": [1, 20, 3, 4, 50, 6], "B": ["a", "b", "c", "D", "e", "f"]})
+    with parquet_file(table1, row_group_size=3) as parquet1:
+        with parquet_file(table2, row_group_size=3) as parquet2:
+            for threads in ("1", "4"):
+                assert do_diff(
+                    parquet1, parquet2, "--summary", "--threads", threads
+                ) == (
+                    1,
+                    "RowGroup 0, Column 0, Row 1:\n-2\n+20\n"
+                    "Summary:\n"
+                    "Column 0 (A): 3 different cells\n"
+                    "Column 1 (B): 1 different cells\n"
+                    "RowGroup 0: 2 different cells\n"
+                    "RowGroup 1: 2 different cells\n"
+                    "Total: 4 different cells\n",
+                )
+
+
+def test_summary_of_equal_files_is_empty():
+    table = pyarrow.table({"A": [1, 2, 3]})
+    with parquet_file(table) as parquet1:
+        with parquet_file(table) as parquet2:
+            assert do_diff(parquet1, parquet2, "--summary") == (0, "")
+
+
+def test_summary_counts_many_differences():
+    values1 = [None if i % 7 == 0 else i for i in range(10000)]
+    values2 = [v if i % 3 else (v or 0) + 1 for i, v in enumerate(values1)]
+    with parquet_file(pyarrow.table({"A": values1})) as parquet1:
+        with parquet_file(pyarrow.table({"A": values2})) as parquet2:
+            code, out = do_diff(parquet1, parquet2, "--summary", "--max-differences=0")
+    assert code == 1
+    assert out == (
+        "Summary:\n"
+        "Column 0 (A): 3334 different cells\n"
+        "RowGroup 0: 3334 different cells\n"
+        "Total: 3334 different cells\n"
+    )
+
+
+def test_loose_row_groups_equal():
+    values = ["value %d" % i if i % 5 else None for i in range(10000)]
+    table = pyarrow.table({"i": list(range(10000)), "s": values})
+    with parquet_file(table, row_group_size=3000, data_page_size=1000) as parquet1:
+        with parquet_file(table, row_group_size=7000) as parquet2:
+            assert do_diff(parquet1, parquet2)[0] == 1  # strict by default
+            assert do_diff(parquet1, parquet2, "--loose-row-groups") == (0, "")
+
+
+def test_loose_row_groups_difference_uses_file_row():
+    table1 = pyarrow.table({"A": [1, 2, 3, 4, 5], "B": ["a", "b", "c", "d", "e"]})
+    table2 = pyarrow.table({"A": [1, 2, 3, 4, 5], "B": ["a", "b", "c", "d", "E"]})
+    with parquet_file(table1, row_group_size=2) as parquet1:
+        with parquet_file(table2, row_group_size=3) as parquet2:
+            assert do_diff(parquet1, parquet2, "--loose-row-groups") == (
+                1,
+                "Column 1, Row 4:\n-e\n+E\n",
+            )
+
+
+def test_loose_row_groups_number_of_rows():
+    table1 = pyarrow.table({"A": [1, 2, 3, 4, 5]})
+    table2 = pyarrow.table({"A": [1, 2, 3, 4]})
+    with parquet_file(table1, row_group_size=2) as parquet1:
+        with parquet_file(table2, row_group_size=3) as parquet2:
+            assert do_diff(parquet1, parquet2, "--loose-row-groups") == (
+                1,
+                "Number of rows:\n-5\n+4\n",
+            )
+
+
+def test_loose_row_groups_summary():
+    table1 = pyarrow.table({"A": [1, 2, 3, 4, 5], "B": [1.0, 2.0, 3.0, 4.0, 5.0]})
+    table2 = pyarrow.table({"A": [1, 20, 3, 40, 5], "B": [1.0, 2.0, 3.0, 4.0, None]})
+    with parquet_file(table1, row_group_size=2) as parquet1:
+        with parquet_file(table2, row_group_size=3) as parquet2:
+            assert do_diff(
+                parquet1, parquet2, "--loose-row-groups", "--summary", "--max-differences=0"
+            ) == (
+                1,
+                "Summary:\n"
+                "Column 0 (A): 2 different cells\n"
+                "Column 1 (B): 1 different cells\n"
+                "Total: 3 different cells\n",
+            )
+
+
+def test_key_ignores_row_order():
+    table1 = pyarrow.table({"id": [1, 2, 3, 4], "s": ["a", "b", None, "d"]})
+    table2 = pyarrow.table({"id": [4, 3, 1, 2], "s": ["d", None, "a", "b"]})
+    with parquet_file(table1, row_group_size=3) as parquet1:
+        with parquet_file(table2, row_group_size=2) as parquet2:
+            assert do_diff(parquet1, parquet2)[0] == 1
+            assert do_diff(parquet1, parquet2, "--key=id") == (0, "")
+
+
+def test_key_added_removed_changed():
+    table1 = pyarrow.table(
+        {"id": [1, 2, 3, 4], "s": ["a", "b", "c", "d"], "f": [1.0, 2.0, 3.0, -0.0]}
+    )
+    table2 = pyarrow.table(
+        {"id": [5, 4, 3, 1], "s": ["e", "d", "C", "a"], "f": [5.0, 0.0, 3.5, 1.0]}
+    )
+    with parquet_file(table1) as parquet1:
+        with parquet_file(table2) as parquet2:
+            assert do_diff(parquet1, parquet2, "--key=id", "--max-differences=10") == (
+                1,
+                "Key id=2:\n-row 1\n+(missing)\n"
+                "Key id=3, Column 1:\n-c\n+C\n"
+                "Key id=3, Column 2:\n-3\n+3.5\n"
+                "Key id=5:\n-(missing)\n+row 0\n"
+                "Rows removed: 1\n"
+                "Rows added: 1\n"
+                "Rows changed: 1\n",
+            )
+            assert do_diff(parquet1, parquet2, "--key=id") == (
+                1,
+                "Key id=2:\n-row 1\n+(missing)\n"
+                "Rows removed: 1\n"
+                "Rows added: 1\n"
+                "Rows changed: 1\n",
+            )
+
+
+def test_key_of_several_columns():
+    table1 = pyarrow.table({"a": [1, 1, None], "b": ["x", "y", "x"], "v": [1, 2, 3]})
+    table2 = pyarrow.table({"a": [None, 1, 1], "b": ["x", "y", "x"], "v": [3, 20, 1]})
+    with parquet_file(table1) as parquet1:
+        with parquet_file(table2) as parquet2:
+            assert do_diff(parquet1, parquet2, "--key=a,b") == (
+                1,
+                "Key a=1, b=y, Column 2:\n-2\n+20\n"
+                "Rows removed: 0\n"
+                "Rows added: 0\n"
+                "Rows changed: 1\n",
+            )
+
+
+def test_key_spills_to_disk():
+    n = 50000
+    ids = list(range(n))
+    table1 = pyarrow.table({"id": ids, "s": ["value %d" % i for i in ids]})
+    shuffled = ids[::-1]
+    values2 = ["value %d" % i for i in shuffled]
+    values2[n - 1 - 31337] = "changed"  # id 31337
+    table2 = pyarrow.table({"id": shuffled, "s": values2})
+    with parquet_file(table1) as parquet1:
+        with parquet_file(table2) as parquet2:
+            assert do_diff(parquet1, parquet2, "--key=id", "--key-memory=100000") == (
+                1,
+                "Key id=31337, Column 1:\n-value 31337\n+changed\n"
+                "Rows removed: 0\n"
+                "Rows added: 0\n"
+                "Rows changed: 1\n",
+            )
+
+
+def test_key_many_added_rows_in_bounded_memory():
+    # File 2's unmatched keys count toward --key-memory, too
+    n = 50000
+    table1 = pyarrow.table({"id": [0, 1]})
+    table2 = pyarrow.table({"id": list(range(1, n))})
+    with parquet_file(table1) as parquet1:
+        with parquet_file(table2) as parquet2:
+            assert do_diff(parquet1, parquet2, "--key=id", "--key-memory=100000") == (
+                1,
+                "Key id=0:\n-row 0\n+(missing)\n"
+                "Rows removed: 1\n"
+                "Rows added: %d\n"
+                "Rows changed: 0\n" % (n - 2),
+            )
+
+    table2 = pyarrow.table({"id": list(range(1, n)) + [n - 1]})
+    with parquet_file(table1) as parquet1:
+        with parquet_file(table2) as parquet2:
+            completed = subprocess.run(
+                [
+                    "/usr/bin/parquet-diff",
+                    "--key=id",
+                    "--key-memory=100000",
+                    str(parquet1),
+                    str(parquet2),
+                ],
+                capture_output=True,
+                encoding="utf-8",
+            )
+    assert completed.returncode == 2
+    assert completed.stderr == "--key is not unique in file 2\n"
+
+
+def test_key_not_unique():
+    table = pyarrow.table({"id": [1, 1]})
+    with parquet_file(table) as parquet1:
+        with parquet_file(table) as parquet2:
+            completed = subprocess.run(
+                ["/usr/bin/parquet-diff", "--key=id", str(parquet1), str(parquet2)],
+                capture_output=True,
+                encoding="utf-8",
+            )
+    assert completed.returncode == 2
+    assert completed.stderr == "--key is not unique in file 1\n"
+
+
+def test_usage_error_is_error():
+    completed = subprocess.run(
+        ["/usr/bin/parquet-diff", "only-one-file.parquet"],
+        capture_output=True,
+        encoding="utf-8",
+    )
+    assert completed.returncode == 2
+
+
+def test_invalid_flag_is_error():
+    table = pyarrow.table({"A": [1, 2]})
+    with parquet_file(table) as path:
+        for flag in ("--row-range=abc", "--buffer-size=0"):
+            completed = subprocess.run(
+                ["/usr/bin/parquet-diff", flag, str(path), str(path)],
+                capture_output=True,
+                encoding="utf-8",
+            )
+            assert completed.returncode == 2
+            assert completed.stdout == ""
+            assert completed.stderr != ""
+
+
+def test_invalid_file_is_error():
+    table = pyarrow.table({"A": [1, 2]})
+    with parquet_file(table) as parquet1, empty_file() as path2:
+        completed = subprocess.run(
+            ["/usr/bin/parquet-diff", str(parquet1), str(path2)],
+            capture_output=True,
+            encoding="utf-8",
+        )
+    assert completed.returncode == 2
+    assert completed.stdout == ""
+    assert completed.stderr != ""
+
+
+def test_corrupt_page_is_error():
+    # A difference must mean the files differ: a page we can't decode is an
+    # error, even after we've started comparing
+    table = pyarrow.table({"A": ["value %d" % i for i in range(10000)]})
+    with parquet_file(table) as parquet1, parquet_file(table) as parquet2:
+        chunk = pyarrow.parquet.ParquetFile(parquet2).metadata.row_group(0).column(0)
+        start = chunk.data_page_offset + chunk.total_compressed_size // 2
+        data = bytearray(parquet2.read_bytes())
+        data[start : start + 100] = b"\xff" * 100
+        parquet2.write_bytes(bytes(data))
+        completed = subprocess.run(
+            ["/usr/bin/parquet-diff", str(parquet1), str(parquet2)],
+            capture_output=True,
+            encoding="utf-8",
+        )
+    assert completed.returncode == 2
+    assert completed.stdout == ""
+    assert completed.stderr != ""
+
+
+def test_required_columns():
+    # A required column has no definition levels
+    schema = pyarrow.schema([pyarrow.field("A", pyarrow.int64(), nullable=False)])
+    table1 = pyarrow.table({"A": [1, 2, 3]}, schema=schema)
+    table2 = pyarrow.table({"A": [1, 5, 3]}, schema=schema)
+    assert arrow_table_diff(table1, table2) == (
+        1,
+        "RowGroup 0, Column 0, Row 1:\n-2\n+5\n",
+    )
+
+
+def test_dictionary_in_different_order():
+    # Same values; the files' dictionaries list them in different orders
+    indices1 = pyarrow.array([0, 1, None, 2, 0], pyarrow.int32())
+    indices2 = pyarrow.array([2, 1, None, 0, 2], pyarrow.int32())
+    table1 = pyarrow.table(
+        {"A": pyarrow.DictionaryArray.from_arrays(indices1, ["a", "b", "c"])}
+    )
+    table2 = pyarrow.table(
+        {"A": pyarrow.DictionaryArray.from_arrays(indices2, ["c", "b", "a"])}
+    )
+    assert arrow_table_diff(table1, table2) == (0, "")
+
+    table2 = pyarrow.table(
+        {
+            "A": pyarrow.DictionaryArray.from_arrays(
+                indices2, ["c", "b", "x"]  # x replaces a
+            )
+        }
+    )
+    assert arrow_table_diff(table1, table2) == (
+        1,
+        "RowGroup 0, Column 0, Row 0:\n-a\n+x\n",
+    )
+
+
+def test_dictionary_difference_across_pages():
+    values1 = ["v%d" % (i % 100) if i % 11 else None for i in range(20000)]
+    values2 = list(values1)
+    values2[17001] = "v3"
+    table1 = pyarrow.table({"A": values1})
+    table2 = pyarrow.table({"A": values2})
+    with parquet_file(table1, use_dictionary=True, data_page_size=1000) as path1:
+        with parquet_file(table2, use_dictionary=True, data_page_size=3000) as path2:
+            assert do_diff(path1, path2, "--summary") == (
+                1,
+                "RowGroup 0, Column 0, Row 17001:\n-v1\n+v3\n"
+                "Summary:\nColumn 0 (A): 1 different cells\n"
+                "RowGroup 0: 1 different cells\nTotal: 1 different cells\n",
+            )
+
+
+def test_dictionary_falls_back_to_plain():
+    # Over 1MB of distinct values: the writer stops using its dictionary
+    values = ["%099d" % i for i in range(20000)]
+    with parquet_file(pyarrow.table({"A": values}), use_dictionary=True) as path1:
+        with parquet_file(pyarrow.table({"A": values}), use_dictionary=False) as path2:
+            assert_same(path1, path1)
+            assert_same(path1, path2)
+            values[19999] = "x"
+            with parquet_file(
+                pyarrow.table({"A": values}), use_dictionary=True
+            ) as path3:
+                assert do_diff(path1, path3) == (
+                    1,
+                    "RowGroup 0, Column 0, Row 19999:\n-%099d\n+x\n" % 19999,
+                )
+
+
+ARROW_TABLE = pyarrow.table(
+    {
+        "i8": pyarrow.array([1, None, -3, 4, 5], pyarrow.int8()),
+        "u32": pyarrow.array([1, 2, 2 ** 32 - 1, None, 5], pyarrow.uint32()),
+        "i64": [1, 2, None, 4, 2 ** 62],
+        "f": [1.5, float("nan"), None, -0.0, 2.0],
+        "s": ["a", None, "b", "a", "c"],
+        "date": pyarrow.array([0, 1, None, 3, 18000], pyarrow.date32()),
+        "ts": pyarrow.array([0, None, 2, 3, 10 ** 12], pyarrow.timestamp("ms")),
+    }
+)
+
+
+def arrow_diff(
+    parquet_table: pyarrow.Table, arrow_table: pyarrow.Table, *args: str
+) -> Tuple[int, str]:
+    with parquet_file(parquet_table, chunk_size=3) as parquet_path:
+        with arrow_file(arrow_table, max_chunksize=2) as arrow_path:
+            return do_diff(parquet_path, arrow_path, "--arrow", *args)
+
+
+def test_arrow_same():
+    assert arrow_diff(ARROW_TABLE, ARROW_TABLE) == (0, "")
+
+
+def test_arrow_dictionary_equals_values():
+    arrow_table = ARROW_TABLE.set_column(
+        4, "s", ARROW_TABLE["s"].combine_chunks().dictionary_encode()
+    )
+    assert arrow_diff(ARROW_TABLE, arrow_table) == (0, "")
+
+
+def test_arrow_parquet_to_arrow_output():
+    with parquet_file(ARROW_TABLE, use_dictionary=True, chunk_size=2) as path1:
+        with empty_file() as path2:
+            subprocess.run(
+                ["/usr/bin/parquet-to-arrow", str(path1), str(path2)], check=True
+            )
+            assert do_diff(path1, path2, "--arrow") == (0, "")
+
+
+def test_arrow_different_values():
+    arrow_table = pyarrow.table(
+        {
+            "A": pyarrow.array([1, 2, 3, 4, 5]),
+            "B": pyarrow.array(["a", None, "b", "x", "c"]).dictionary_encode(),
+        }
+    )
+    parquet_table = pyarrow.table(
+        {"A": [1, 2, None, 4, 5], "B": ["a", None, "b", "y", "c"]}
+    )
+    assert arrow_diff(parquet_table, arrow_table, "--max-differences=2") == (
+        1,
+        "Column 0, Row 2:\n-(null)\n+3\nColumn 1, Row 3:\n-y\n+x\n",
+    )
+
+
+def test_arrow_summary():
+    arrow_table = pyarrow.table({"A": [1, 2, 3, 4, 5]})
+    parquet_table = pyarrow.table({"A": [1, 0, 3, 0, 5]})
+    assert arrow_diff(parquet_table, arrow_table, "--summary") == (
+        1,
+        "Column 0, Row 1:\n-0\n+2\n"
+        "Summary:\nColumn 0 (A): 2 different cells\nTotal: 2 different cells\n",
+    )
+
+
+def test_arrow_different_type():
+    arrow_table = pyarrow.table({"A": pyarrow.array([1, 2], pyarrow.int32())})
+    parquet_table = pyarrow.table({"A": pyarrow.array([1, 2], pyarrow.int64())})
+    assert arrow_diff(parquet_table, arrow_table) == (
+        1,
+        "Column 0 (A) Arrow type:\n-int64\n+int32\n",
+    )
+
+
+def test_arrow_different_number_of_rows():
+    parquet_table = pyarrow.table({"A": [1, 2, 3]})
+    arrow_table = pyarrow.table({"A": [1, 2, 3, 4]})
+    assert arrow_diff(parquet_table, arrow_table) == (
+        1,
+        "Number of rows:\n-3\n+4\n",
+    )
+
+
+def test_columns():
+    table1 = pyarrow.table({"A": [1, 2, 3], "B": ["a", "b", "c"], "C": [1, 2, 3]})
+    table2 = pyarrow.table({"A": [1, 2, 3], "B": ["a", "x", "c"], "C": [1, 2, 4]})
+    with parquet_file(table1) as path1:
+        with parquet_file(table2) as path2:
+            assert do_diff(path1, path2, "--columns=A") == (0, "")
+            assert do_diff(path1, path2, "--columns=A,C") == (
+                1,
+                "RowGroup 0, Column 2, Row 2:\n-3\n+4\n",
+            )
+
+
+def test_columns_not_found():
+    table = pyarrow.table({"A": [1]})
+    with parquet_file(table) as path1:
+        completed = subprocess.run(
+            ["/usr/bin/parquet-diff", "--columns=X", str(path1), str(path1)],
+            capture_output=True,
+            encoding="utf-8",
+        )
+    assert completed.returncode == 2
+    assert completed.stderr == "--columns column does not exist: X\n"
+
+
+def test_row_range():
+    values1 = list(range(100))
+    values2 = [0 if i in (5, 50, 95) else i for i in values1]
+    with parquet_file(pyarrow.table({"A": values1}), chunk_size=30) as path1:
+        with parquet_file(pyarrow.table({"A": values2}), chunk_size=30) as path2:
+            assert do_diff(path1, path2, "--row-range=6-95") == (
+                1,
+                "RowGroup 1, Column 0, Row 20:\n-50\n+0\n",
+            )
+            assert do_diff(path1, path2, "--row-range=51-95") == (0, "")
+            assert do_diff(
+                path1, path2, "--row-range=6-96", "--loose-row-groups", "--summary"
+            ) == (
+                1,
+                "Column 0, Row 50:\n-50\n+0\n"
+                "Summary:\nColumn 0 (A): 2 different cells\nTotal: 2 different cells\n",
+            )
+
+
+def test_row_range_dictionary():
+    values1 = ["v%d" % (i % 7) for i in range(1000)]
+    values2 = list(values1)
+    values2[3] = "x"
+    values2[700] = "x"
+    table1 = pyarrow.table({"A": values1})
+    table2 = pyarrow.table({"A": values2})
+    with parquet_file(table1, use_dictionary=True, data_page_size=100) as path1:
+        with parquet_file(table2, use_dictionary=True, data_page_size=100) as path2:
+            assert do_diff(path1, path2, "--row-range=4-2000") == (
+                1,
+                "RowGroup 0, Column 0, Row 700:\n-v0\n+x\n",
+            )
+
+
+def test_row_range_still_compares_row_counts():
+    table1 = pyarrow.table({"A": [1, 2, 3]})
+    table2 = pyarrow.table({"A": [1, 2, 3, 4]})
+    with parquet_file(table1) as path1:
+        with parquet_file(table2) as path2:
+            assert do_diff(path1, path2, "--row-range=0-2", "--loose-row-groups") == (
+                1,
+                "Number of rows:\n-3\n+4\n",
+            )
+
+
+NESTED_TABLE = pyarrow.table(
+    {
+        "L": pyarrow.array(
+            [[1, 2], [], None, [3, None, 4]], pyarrow.list_(pyarrow.int64())
+        ),
+        "S": pyarrow.array(
+            [{"x": "a"}, None, {"x": None}, {"x": "d"}],
+            pyarrow.struct([("x", pyarrow.string())]),
+        ),
+    }
+)
+
+
+def nested_diff(values1, values2, type, *args: str) -> Tuple[int, str]:
+    table1 = pyarrow.table({"A": pyarrow.array(values1, type)})
+    table2 = pyarrow.table({"A": pyarrow.array(values2, type)})
+    with parquet_file(table1) as path1:
+        with parquet_file(table2) as path2:
+            return do_diff(path1, path2, *args)
+
+
+def test_nested_same():
+    assert_arrow_table_identity(NESTED_TABLE)
+
+
+def test_nested_list_different_item():
+    assert nested_diff(
+        [[1, 2], [3, 4, 5]], [[1, 2], [3, 6, 5]], pyarrow.list_(pyarrow.int32())
+    ) == (1, "RowGroup 0, Column 0, Row 1, Item 1:\n-4\n+6\n")
+
+
+def test_nested_list_shorter():
+    assert nested_diff(
+        [[1], [2, 3], [4]], [[1], [2], [4]], pyarrow.list_(pyarrow.int32())
+    ) == (1, "RowGroup 0, Column 0, Row 1, Item 1:\n-3\n+(end of row)\n")
+    assert nested_diff(
+        [[1], [2], [4]], [[1], [2, 3], [4]], pyarrow.list_(pyarrow.int32())
+    ) == (1, "RowGroup 0, Column 0, Row 1, Item 1:\n-(end of row)\n+3\n")
+
+
+def test_nested_list_empty_vs_null():
+    assert nested_diff(
+        [["a"], [], ["b", None]],
+        [["a"], None, ["b", "c"]],
+        pyarrow.list_(pyarrow.string()),
+        "--max-differences=2",
+    ) == (
+        1,
+        "RowGroup 0, Column 0, Row 1, Item 0:\n-(empty)\n+(null A)\n"
+        "RowGroup 0, Column 0, Row 2, Item 1:\n-(null)\n+c\n",
+    )
+
+
+def test_nested_struct():
+    type = pyarrow.struct([("x", pyarrow.int32())])
+    assert nested_diff(
+        [{"x": 1}, {"x": None}, None], [{"x": 1}, None, {"x": None}], type, "--summary"
+    ) == (
+        1,
+        "RowGroup 0, Column 0, Row 1:\n-(null)\n+(null A)\n"
+        "Summary:\nColumn 0 (x): 2 different cells\n"
+        "RowGroup 0: 2 different cells\nTotal: 2 different cells\n",
+    )
+
+
+def test_nested_many_batches():
+    # Rows straddle batch and page boundaries; differences come after them
+    values1 = [list(range(i % 7)) for i in range(20000)]
+    values2 = [list(v) for v in values1]
+    values2[15004] = [0, 1, 9]
+    values2[19998] = [0, 1, 2, 3, 4, 5, 6]
+    type = pyarrow.list_(pyarrow.int32())
+    assert nested_diff(values1, values2, type, "--max-differences=3") == (
+        1,
+        "RowGroup 0, Column 0, Row 15004, Item 2:\n-2\n+9\n"
+        "RowGroup 0, Column 0, Row 19998, Item 6:\n-(end of row)\n+6\n",
+    )
+
+
+def test_nested_loose_row_groups_and_row_range():
+    values1 = [[i, i] for i in range(100)]
+    values2 = [[i, i] for i in range(100)]
+    values2[10] = [10, 0]
+    values2[70] = [70]
+    table1 = pyarrow.table({"A": values1})
+    table2 = pyarrow.table({"A": values2})
+    with parquet_file(table1, chunk_size=30) as path1:
+        with parquet_file(table2, chunk_size=40) as path2:
+            assert do_diff(
+                path1, path2, "--loose-row-groups", "--max-differences=2"
+            ) == (
+                1,
+                "Column 0, Row 10, Item 1:\n-10\n+0\n"
+                "Column 0, Row 70, Item 1:\n-70\n+(end of row)\n",
+            )
+            assert do_diff(
+                path1, path2, "--loose-row-groups", "--row-range=11-100"
+            ) == (1, "Column 0, Row 70, Item 1:\n-70\n+(end of row)\n")
+    with parquet_file(table1, chunk_size=50) as path1:
+        with parquet_file(table2, chunk_size=50) as path2:
+            assert do_diff(path1, path2, "--row-range=11-100") == (
+                1,
+                "RowGroup 1, Column 0, Row 20, Item 1:\n-70\n+(end of row)\n",
+            )
+
+
+def test_nested_columns_flag():
+    table1 = pyarrow.table({"A": [1], "L": [[1, 2]]})
+    table2 = pyarrow.table({"A": [2], "L": [[1, 3]]})
+    with parquet_file(table1) as path1:
+        with parquet_file(table2) as path2:
+            # "L.list.item" or "L.list.element", depending on pyarrow
+            leaf = pyarrow.parquet.ParquetFile(str(path1)).schema.column(1).path
+            assert do_diff(path1, path2, "--columns=" + leaf) == (
+                1,
+                "RowGroup 0, Column 1, Row 0, Item 1:\n-2\n+3\n",
+            )
+
+
+def test_nested_key_not_supported():
+    table = pyarrow.table({"A": [1], "S": [{"x": 1}]})
+    with parquet_file(table) as path:
+        completed = subprocess.run(
+            ["/usr/bin/parquet-diff", "--key=A", str(path), str(path)],
+            capture_output=True,
+            encoding="utf-8",
+        )
+    assert completed.returncode == 2
+    assert completed.stderr == "Column 1 (x) is nested, and --key doesn't support that\n"
@@ -0,0 +1,113 @@
+import json
+import subprocess
+from pathlib import Path
+
+import pyarrow
+
+from .util import parquet_file
+
+
+def do_grep(needle: str, parquet_path: Path, format: str, **kwargs) -> bytes:
+    cmd = ["/usr/bin/parquet-grep", needle, str(parquet_path), format]
+    for k, v in kwargs.items():
+        cmd.append(k)
+        if v is not None:
+            cmd.append(v)
+    try:
+        completed = subprocess.run(cmd, capture_output=True, check=True)
+    except subprocess.CalledProcessError as err:
+        # Rewrite error so it's easy to read in test-result stack trace
+        raise RuntimeError(
+            "Process failed with code %d: %s"
+            % (err.returncode, err.stdout + err.stderr)
+        ) from None
+
+    if len(completed.stderr):
+        raise RuntimeError("Stderr should be empty, but was: %s" % completed.stderr)
+    return completed.stdout
+
+
+def _grep_json(needle: str, table: pyarrow.Table, **kwargs):
+    with parquet_file(table, **kwargs) as parquet_path:
+        return json.loads(do_grep(needle, parquet_path, "json"))
+
+
+TABLE = pyarrow.table(
+    {
+        "id": [1, 2, 3, 4, 5],
+        "a": ["apple", None, "banana", "cherry", "apple pie"],
+        "b": ["x", "pineapple", "y", None, "z"],
+    }
+)
+APPLE_ROWS = [
+    {"id": 1, "a": "apple", "b": "x"},
+    {"id": 2, "a": None, "b": "pineapple"},
+    {"id": 5, "a": "apple pie", "b": "z"},
+]
+
+
+def test_plain():
+    assert _grep_json("apple", TABLE) == APPLE_ROWS
+
+
+def test_dictionary():
+    assert _grep_json("apple", TABLE, use_dictionary=True) == APPLE_ROWS
+
+
+def test_data_page_v2():
+    assert _grep_json("apple", TABLE, data_page_version="2.0") == APPLE_ROWS
+
+
+def test_required_columns():
+    table = pyarrow.table(
+        {"id": [1, 2, 3], "a": ["apple", "kiwi", "pineapple"]},
+        schema=pyarrow.schema(
+            [
+                pyarrow.field("id", pyarrow.int64(), nullable=False),
+                pyarrow.field("a", pyarrow.string(), nullable=False),
+            ]
+        ),
+    )
+    for kwargs in [dict(), dict(use_dictionary=True, data_page_version="2.0")]:
+        assert _grep_json("apple", table, **kwargs) == [
+            {"id": 1, "a": "apple"},
+            {"id": 3, "a": "pineapple"},
+        ]
+
+
+def test_csv():
+    with parquet_file(TABLE, use_dictionary=True) as parquet_path:
+        assert do_grep("an", parquet_path, "csv") == b"id,a,b\r\n3,banana,y"
+
+
+def test_no_match():
+    assert _grep_json("durian", TABLE, use_dictionary=True) == []
+
+
+def test_ignore_non_string_columns():
+    assert _grep_json("3", TABLE) == []
+
+
+def test_many_row_groups_and_pages():
+    # Matches straddle page and row-group boundaries; most pages have none
+    values = ["value %d" % i for i in range(10000)]
+    table = pyarrow.table({"i": list(range(10000)), "s": values})
+    for use_dictionary in (False, True):
+        result = _grep_json(
+            "ue 99",
+            table,
+            use_dictionary=use_dictionary,
+            chunk_size=3000,
+            data_page_size=1000,
+        )
+        assert [row["i"] for row in result] == [
+            i for i, v in enumerate(values) if "ue 99" in v
+        ]
+
+
+def test_max_rows():
+    with parquet_file(TABLE) as parquet_path:
+        result = json.loads(
+            do_grep("apple", parquet_path, "json", **{"--max-rows": "2"})
+        )
+    assert result == APPLE_ROWS[:2]
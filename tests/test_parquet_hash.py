@@ -0,0 +1,157 @@
+import subprocess
+from pathlib import Path
+from typing import List, Tuple
+
+import pyarrow
+
+from .util import parquet_file
+from .test_parquet_diff import do_diff
+
+
+def do_hash(parquet_path: Path, *args: str) -> Tuple[str, List[Tuple[str, str]]]:
+    """
+    Return (file hash, [(column hash, column name), ...]).
+    """
+    completed = subprocess.run(
+        ["/usr/bin/parquet-hash", *args, str(parquet_path)],
+        capture_output=True,
+        check=True,
+        encoding="utf-8",
+    )
+    if completed.stderr:
+        raise RuntimeError("Stderr should be empty, but was: %s" % completed.stderr)
+    lines = completed.stdout.splitlines()
+    return lines[0], [tuple(line.split(" ", 1)) for line in lines[1:]]
+
+
+def table_hash(table: pyarrow.Table, **kwargs) -> Tuple[str, List[Tuple[str, str]]]:
+    with parquet_file(table, **kwargs) as parquet_path:
+        return do_hash(parquet_path)
+
+
+TABLE = pyarrow.table(
+    {
+        "i": pyarrow.array([1, None, 3, 4], pyarrow.int32()),
+        "f": [1.5, 2.0, None, -0.0],
+        "s": ["a", "bb", "a", None],
+    }
+)
+
+
+def test_hash_is_stable():
+    # If you change how we hash, change kHashVersion and these hashes
+    assert table_hash(TABLE) == (
+        "761c4fabcbc2d52bd60e57a5cc370f73",
+        [
+            ("a2d0c7bd15960b651b2e85da016ce5b3", "i"),
+            ("881a3d44315b31f08db3917c642df413", "f"),
+            ("c27381fa2f04a9994855f4dd614619fe", "s"),
+        ],
+    )
+
+
+def test_loose_about_encoding_versions_and_row_groups():
+    expected = table_hash(TABLE)
+    assert table_hash(TABLE, use_dictionary=False) == expected
+    assert table_hash(TABLE, use_dictionary=True) == expected
+    assert table_hash(TABLE, version="1.0") == expected
+    assert table_hash(TABLE, data_page_version="2.0") == expected
+    assert table_hash(TABLE, row_group_size=1) == expected
+
+
+def test_loose_about_negative_zero():
+    table1 = pyarrow.table({"f": [0.0]})
+    table2 = pyarrow.table({"f": [-0.0]})
+    assert table_hash(table1) == table_hash(table2)
+
+
+def test_strict_about_values():
+    table2 = pyarrow.table(
+        {
+            "i": TABLE["i"],
+            "f": TABLE["f"],
+            "s": ["a", "bb", "A", None],
+        }
+    )
+    file_hash1, columns1 = table_hash(TABLE)
+    file_hash2, columns2 = table_hash(table2)
+    assert file_hash1 != file_hash2
+    assert columns1[:2] == columns2[:2]
+    assert columns1[2] != columns2[2]
+
+
+def test_strict_about_null():
+    table1 = pyarrow.table({"s": ["", None]})
+    table2 = pyarrow.table({"s": [None, ""]})
+    assert table_hash(table1) != table_hash(table2)
+
+
+def test_strict_about_types():
+    table1 = pyarrow.table({"A": pyarrow.array([1, 2], pyarrow.int32())})
+    table2 = pyarrow.table({"A": pyarrow.array([1, 2], pyarrow.int64())})
+    table3 = pyarrow.table({"A": pyarrow.array([1, 2], pyarrow.int16())})
+    hashes = {table_hash(t)[0] for t in (table1, table2, table3)}
+    assert len(hashes) == 3
+
+
+def test_strict_about_column_names():
+    assert table_hash(pyarrow.table({"A": [1]}))[0] != table_hash(pyarrow.table({"B": [1]}))[0]
+
+
+def test_agrees_with_parquet_diff_about_required_columns():
+    required = pyarrow.schema([pyarrow.field("A", pyarrow.int64(), nullable=False)])
+    table1 = pyarrow.table({"A": [1, 2]}, schema=required)
+    table2 = pyarrow.table({"A": [1, 2]})  # optional
+    with parquet_file(table1) as path1, parquet_file(table2) as path2:
+        assert do_diff(path1, path2)[0] == 1
+        assert do_hash(path1)[0] != do_hash(path2)[0]
+        assert do_diff(path1, path1)[0] == 0
+        assert do_hash(path1) == table_hash(table1, row_group_size=1)
+
+
+NESTED_TABLE = pyarrow.table(
+    {
+        "id": [1, 2, 3, 4],
+        "tags": pyarrow.array(
+            [["a", "b"], [], None, ["c", None]], pyarrow.list_(pyarrow.string())
+        ),
+    }
+)
+
+
+def test_nested_columns():
+    file_hash, columns = table_hash(NESTED_TABLE)
+    assert [name for _, name in columns] == ["id", "tags.list.element"]
+    assert table_hash(NESTED_TABLE, row_group_size=1) == (file_hash, columns)
+    assert table_hash(NESTED_TABLE, use_dictionary=True) == (file_hash, columns)
+
+    # An empty list, a null list and a list of one null all differ, as in
+    # parquet-diff
+    for tags in (
+        [["a", "b"], [None], None, ["c", None]],
+        [["a", "b"], None, None, ["c", None]],
+        [["a"], ["b"], None, ["c", None]],
+    ):
+        table2 = NESTED_TABLE.set_column(
+            1, "tags", pyarrow.array(tags, pyarrow.list_(pyarrow.string()))
+        )
+        file_hash2, columns2 = table_hash(table2)
+        assert file_hash2 != file_hash
+        assert columns2[0] == columns[0]
+        assert columns2[1] != columns[1]
+
+
+def test_threads():
+    assert table_hash(TABLE) == table_hash(TABLE)
+    with parquet_file(TABLE) as parquet_path:
+        assert do_hash(parquet_path, "--threads=1") == do_hash(parquet_path, "--threads=3")
+
+
+def test_reader_flags():
+    # Buffered streams (with tiny buffers, over many pages) and memory-mapped
+    # files read the same values
+    table = pyarrow.table({"s": ["value %d" % i for i in range(5000)]})
+    with parquet_file(table, data_page_size=1000) as parquet_path:
+        expected = do_hash(parquet_path)
+        assert do_hash(parquet_path, "--buffered-stream", "--buffer-size=100") == expected
+        assert do_hash(parquet_path, "--mmap") == expected
@@ -0,0 +1,197 @@
+import datetime
+import json
+import subprocess
+from pathlib import Path
+
+import pyarrow
+
+from .util import parquet_file
+
+
+def do_stats(parquet_path: Path, **kwargs):
+    cmd = ["/usr/bin/parquet-stats", str(parquet_path)]
+    for k, v in kwargs.items():
+        cmd.append(k)
+        if v is not None:
+            cmd.append(v)
+    try:
+        completed = subprocess.run(cmd, capture_output=True, check=True)
+    except subprocess.CalledProcessError as err:
+        # Rewrite error so it's easy to read in test-result stack trace
+        raise RuntimeError(
+            "Process failed with code %d: %s"
+            % (err.returncode, err.stdout + err.stderr)
+        ) from None
+
+    if len(completed.stderr):
+        raise RuntimeError("Stderr should be empty, but was: %s" % completed.stderr)
+    return json.loads(completed.stdout)
+
+
+def _table_stats(table: pyarrow.Table, **kwargs):
+    with parquet_file(table) as parquet_path:
+        return do_stats(parquet_path, **kwargs)
+
+
+def test_numbers():
+    stats = _table_stats(
+        pyarrow.table({"A": pyarrow.array([3, None, 1, 3, 2], pyarrow.int64())})
+    )
+    assert stats == {
+        "num_rows": 5,
+        "columns": [
+            {
+                "name": "A",
+                "type": "int64",
+                "null_count": 1,
+                "distinct_estimate": 3,
+                "min": 1,
+                "max": 3,
+                "mean": 2.25,
+                "top_values": [
+                    {"value": 3, "count": 2},
+                    {"value": 1, "count": 1},
+                    {"value": 2, "count": 1},
+                ],
+            }
+        ],
+    }
+
+
+def test_nan_and_inf_are_null():
+    stats = _table_stats(
+        pyarrow.table({"A": [1.5, float("nan"), float("inf"), -0.5, None]})
+    )
+    column = stats["columns"][0]
+    assert column["type"] == "float64"
+    assert column["null_count"] == 3
+    assert column["min"] == -0.5
+    assert column["max"] == 1.5
+    assert column["mean"] == 0.5
+
+
+def test_strings():
+    stats = _table_stats(
+        pyarrow.table({"A": ["", "a", "bb", "ccc", "dddd", "a", None]}),
+        **{"--top-values": "1"},
+    )
+    assert stats["columns"] == [
+        {
+            "name": "A",
+            "type": "string",
+            "null_count": 1,
+            "distinct_estimate": 5,
+            "min": "",
+            "max": "dddd",
+            "mean_length": 11 / 6,
+            "length_histogram": [
+                {"min_length": 0, "max_length": 0, "count": 1},
+                {"min_length": 1, "max_length": 1, "count": 2},
+                {"min_length": 2, "max_length": 3, "count": 2},
+                {"min_length": 4, "max_length": 7, "count": 1},
+            ],
+            "top_values": [{"value": "a", "count": 2}],
+        }
+    ]
+
+
+def test_dates_and_timestamps():
+    stats = _table_stats(
+        pyarrow.table(
+            {
+                "date": pyarrow.array(
+                    [datetime.date(2021, 4, 5), datetime.date(2020, 1, 1)],
+                    pyarrow.date32(),
+                ),
+                "ts": pyarrow.array(
+                    [datetime.datetime(2021, 4, 5, 1, 2, 3), None],
+                    pyarrow.timestamp("ms"),
+                ),
+            }
+        )
+    )
+    date, ts = stats["columns"]
+    assert date["type"] == "date32"
+    assert date["min"] == "2020-01-01"
+    assert date["max"] == "2021-04-05"
+    assert "mean" not in date
+    assert ts["type"] == "timestamp[ms]"
+    assert ts["null_count"] == 1
+    assert ts["min"] == "2021-04-05T01:02:03Z"
+
+
+def test_all_null():
+    stats = _table_stats(pyarrow.table({"A": pyarrow.array([None], pyarrow.int32())}))
+    column = stats["columns"][0]
+    assert column["min"] is None
+    assert column["max"] is None
+    assert column["mean"] is None
+    assert column["distinct_estimate"] == 0
+    assert column["top_values"] == []
+
+
+def test_required_column():
+    table = pyarrow.table(
+        {"A": [1, 2, 2]},
+        schema=pyarrow.schema([pyarrow.field("A", pyarrow.int64(), nullable=False)]),
+    )
+    stats = _table_stats(table)
+    assert stats["columns"][0]["null_count"] == 0
+    assert stats["columns"][0]["top_values"] == [
+        {"value": 2, "count": 2},
+        {"value": 1, "count": 1},
+    ]
+
+
+def misra_gries_top_values(values, n_counters=1024, n_top=10):
+    counters = {}
+    for value in values:
+        if value in counters:
+            counters[value] += 1
+        elif len(counters) < n_counters:
+            counters[value] = 1
+        else:
+            counters = {v: c - 1 for v, c in counters.items() if c > 1}
+    top = sorted(counters.items(), key=lambda item: (-item[1], item[0]))[:n_top]
+    return [{"value": v, "count": c} for v, c in top]
+
+
+def test_top_values_with_more_distinct_values_than_counters():
+    # 1,000 frequent values fill most counters; a long unique tail then
+    # decrements them all, again and again
+    values = ["hot"] * 5000
+    for i in range(1000):
+        values.extend(["frequent %d" % i] * 20)
+    values.extend("tail %d" % i for i in range(100000))
+    for i in range(1000):
+        values.extend(["frequent %d" % i] * 3)
+    stats = _table_stats(pyarrow.table({"A": values}))
+    top = stats["columns"][0]["top_values"]
+    assert top == misra_gries_top_values(values)
+    # Counts are lower bounds, off by at most len(values) / 1024
+    assert top[0]["value"] == "hot"
+    assert 5000 - len(values) // 1024 <= top[0]["count"] <= 5000
+
+
+def test_many_columns_in_parallel():
+    table = pyarrow.table({"c%d" % i: list(range(i, i + 100)) for i in range(20)})
+    stats = _table_stats(table, **{"--threads": "4"})
+    assert [c["name"] for c in stats["columns"]] == ["c%d" % i for i in range(20)]
+    assert [c["min"] for c in stats["columns"]] == list(range(20))
+    assert all(90 <= c["distinct_estimate"] <= 110 for c in stats["columns"])
+
+
+def test_zero_rows():
+    stats = _table_stats(pyarrow.table({"A": pyarrow.array([], pyarrow.string())}))
+    assert stats["num_rows"] == 0
+    assert stats["columns"][0]["null_count"] == 0
+    assert stats["columns"][0]["length_histogram"] == []
+
+
+def test_zero_row_groups_from_file():
+    stats = do_stats(
+        Path(__file__).parent / "files" / "column-A-string-with-no-row-groups.parquet"
+    )
+    assert stats["num_rows"] == 0
+    assert stats["columns"][0]["name"] == "A"
+    assert stats["columns"][0]["top_values"] == []
@@ -24,7 +24,8 @@ def do_convert(parquet_path: Path, format: str, **kwargs) -> str:
     cmd = ["/usr/bin/parquet-to-text-stream", str(parquet_path), format]
     for k, v in kwargs.items():
         cmd.append(k)
-        cmd.append(v)
+        if v is not None:
+            cmd.append(v)
     try:
         completed = subprocess.run(cmd, capture_output=True, check=True)
     except subprocess.CalledProcessError as err:
@@ -247,6 +248,163 @@ def test_convert_text_dictionaries_over_batch_size():
         ).encode("utf-8")
 
 
+def test_decode_pages_same_as_column_reader():
+    table = pyarrow.table(
+        {
+            "i32": pyarrow.array(
+                [None if i % 7 == 0 else i * 31 - 500 for i in range(1000)],
+                pyarrow.int32(),
+            ),
+            "i64": pyarrow.array(
+                [None if i % 5 == 0 else i * 4611686018427387 for i in range(1000)],
+                pyarrow.int64(),
+            ),
+            "f64": pyarrow.array(
+                [None if i % 3 == 0 else i / 7 for i in range(1000)], pyarrow.float64()
+            ),
+            "str": [None if i % 11 == 0 else "s%d" % (i % 13) for i in range(1000)],
+        }
+    )
+    for kwargs in [
+        dict(use_dictionary=False),
+        dict(use_dictionary=True),
+        dict(use_dictionary=False, data_page_version="2.0", data_page_size=500),
+        dict(use_dictionary=True, data_page_version="2.0", data_page_size=100),
+    ]:
+        with parquet_file(table, chunk_size=400, **kwargs) as parquet_path:
+            for row_range in ["0-1000", "399-801", "400-800", "1000-1000"]:
+                for format in ["csv", "json"]:
+                    assert do_convert(
+                        parquet_path, format, **{"--row-range": row_range}
+                    ) == do_convert(
+                        parquet_path,
+                        format,
+                        **{"--row-range": row_range, "--decode-pages=false": None},
+                    )
+
+
+def test_convert_required_columns():
+    schema = pyarrow.schema(
+        [
+            pyarrow.field("i64", pyarrow.int64(), nullable=False),
+            pyarrow.field("str", pyarrow.string(), nullable=False),
+        ]
+    )
+    table = pyarrow.table(
+        {"i64": list(range(100)), "str": ["s%d" % (i % 7) for i in range(100)]},
+        schema=schema,
+    )
+    expected = canonical_json(
+        [{"i64": i, "str": "s%d" % (i % 7)} for i in range(40, 60)]
+    ).encode("utf-8")
+    for kwargs in [
+        dict(use_dictionary=False),
+        dict(use_dictionary=True, data_page_version="2.0", data_page_size=100),
+    ]:
+        with parquet_file(table, chunk_size=50, **kwargs) as parquet_path:
+            for decode_pages in ["true", "false"]:
+                assert (
+                    do_convert(
+                        parquet_path,
+                        "json",
+                        **{
+                            "--row-range": "40-60",
+                            "--decode-pages=" + decode_pages: None,
+                        },
+                    )
+                    == expected
+                )
+
+
+def _invalid_utf8_table() -> pyarrow.Table:
+    # pyarrow won't build invalid strings for us; view binary as string
+    return pyarrow.table(
+        {
+            "A": pyarrow.array(
+                [b"ok", b"caf\xc3\xa9 long enough for words", b"x\xffy", b"\xe2\x82"],
+                pyarrow.binary(),
+            ).view(pyarrow.string())
+        }
+    )
+
+
+def test_validate_utf8_default_copies_bytes():
+    with parquet_file(_invalid_utf8_table()) as parquet_path:
+        assert (
+            do_convert(parquet_path, "csv")
+            == b"A\r\nok\r\ncaf\xc3\xa9 long enough for words\r\nx\xffy\r\n\xe2\x82"
+        )
+
+
+def test_validate_utf8_replace():
+    with parquet_file(_invalid_utf8_table()) as parquet_path:
+        # "\xe2\x82" is one truncated sequence => one U+FFFD
+        assert (
+            do_convert(parquet_path, "csv", **{"--validate-utf8": "replace"})
+            == "A\r\nok\r\ncafé long enough for words\r\nx\ufffdy\r\n\ufffd".encode("utf-8")
+        )
+        assert do_convert(
+            parquet_path, "json", **{"--validate-utf8": "replace"}
+        ) == canonical_json(
+            [
+                {"A": "ok"},
+                {"A": "café long enough for words"},
+                {"A": "x\ufffdy"},
+                {"A": "\ufffd"},
+            ]
+        ).encode(
+            "utf-8"
+        )
+
+
+def test_validate_utf8_error():
+    with parquet_file(_invalid_utf8_table()) as parquet_path:
+        for format in ["csv", "json"]:
+            completed = subprocess.run(
+                [
+                    "/usr/bin/parquet-to-text-stream",
+                    str(parquet_path),
+                    format,
+                    "--validate-utf8",
+                    "error",
+                ],
+                capture_output=True,
+            )
+            assert completed.returncode == 1
+            assert completed.stderr == b"Invalid UTF-8 in row 2, column 0 (A)\n"
+
+
+def test_dictionary_memory_spills_to_disk():
+    table = pyarrow.table(
+        {
+            "A": pyarrow.array(["x%d" % (i % 50) for i in range(200)]),
+            "B": pyarrow.array([i % 30 for i in range(200)], pyarrow.int64()),
+        }
+    )
+    with parquet_file(table, use_dictionary=True, chunk_size=100) as parquet_path:
+        expected = do_convert(parquet_path, "csv")
+        # 0-byte budget: every dictionary spills, and output is the same
+        completed = subprocess.run(
+            [
+                "/usr/bin/parquet-to-text-stream",
+                str(parquet_path),
+                "csv",
+                "--dictionary-memory",
+                "0",
+                "--report-dictionary-memory",
+            ],
+            capture_output=True,
+            check=True,
+        )
+        assert completed.stdout == expected
+        # A: 50 * (4-byte offset + 4-byte length) + 140 bytes of text
+        # B: 30 * 8 bytes
+        assert (
+            completed.stderr
+            == b"Peak dictionary memory: 0 bytes in RAM, 780 bytes spilled to disk\n"
+        )
+
+
 def test_convert_na_only_categorical():
     table = pyarrow.table(
         {"A": pyarrow.array([None], type=pyarrow.string()).dictionary_encode()}
@@ -338,6 +496,220 @@ def test_column_and_row_range_clip_max():
     )
 
 
+def test_row_range_set():
+    # Ranges may overlap, touch and come in any order; row groups and pages
+    # between them are skipped
+    table = pyarrow.table(
+        {
+            "A": pyarrow.array(range(10000), pyarrow.int64()),
+            "B": ["s%d" % (i % 13) for i in range(10000)],
+        }
+    )
+    ranges = "9000-9003,0-2,5000-5002,1-3,5002-5003,9999-20000"
+    rows = [0, 1, 2, 5000, 5001, 5002, 9000, 9001, 9002, 9999]
+    for use_dictionary in (False, True):
+        with parquet_file(
+            table, use_dictionary=use_dictionary, chunk_size=3000, data_page_size=1000
+        ) as parquet_path:
+            for decode_pages in ("--decode-pages=true", "--decode-pages=false"):
+                result = do_convert(
+                    parquet_path, "json", **{"--row-range": ranges, decode_pages: None}
+                )
+                assert json.loads(result) == [
+                    {"A": i, "B": "s%d" % (i % 13)} for i in rows
+                ]
+            assert do_convert(
+                parquet_path,
+                "csv",
+                **{"--row-range": ranges, "--max-rows": "4", "--column-range": "0-1"},
+            ) == b"A\r\n0\r\n1\r\n2\r\n5000"
+            assert do_convert(
+                parquet_path,
+                "csv",
+                **{"--row-range": ranges, "--sort-by": "A:desc", "--max-rows": "2"},
+            ) == b"A,B\r\n9999,s2\r\n9002,s6"
+
+
+def test_column_range_set():
+    _test_convert_via_arrow(
+        pyarrow.table(
+            {
+                "A": ["a0", "a1"],
+                "B": ["b0", "b1"],
+                "C": ["c0", "c1"],
+                "D": ["d0", "d1"],
+                "E": ["e0", "e1"],
+            }
+        ),
+        "A,D,E\r\na1,d1,e1",
+        '[{"A":"a1","D":"d1","E":"e1"}]',
+        **{"--column-range": "3-4,0-1,4-9", "--row-range": "1-2,7-9"},
+    )
+
+
+def test_range_set_invalid():
+    completed = subprocess.run(
+        ["/usr/bin/parquet-to-text-stream", "--row-range=0-5,x", "x.parquet", "csv"],
+        capture_output=True,
+    )
+    assert completed.returncode == 1
+    assert b"row_range does not look like" in completed.stderr
+
+
+def test_multiple_outputs(tmp_path):
+    table = pyarrow.table({"A": ["a", None, "c,d"], "B": [1.5, 2.0, None]})
+    with parquet_file(table) as parquet_path:
+        stdout = subprocess.run(
+            [
+                "/usr/bin/parquet-to-text-stream",
+                str(parquet_path),
+                "csv",
+                "json:%s" % (tmp_path / "out.json"),
+                "csv:%s" % (tmp_path / "out.csv"),
+            ],
+            capture_output=True,
+            check=True,
+        ).stdout
+        expect_csv = b'A,B\r\na,1.5\r\n,2\r\n"c,d",'
+        assert stdout == expect_csv
+        assert (tmp_path / "out.csv").read_bytes() == expect_csv
+        assert (tmp_path / "out.json").read_bytes() == canonical_json(
+            [{"A": "a", "B": 1.5}, {"A": None, "B": 2}, {"A": "c,d", "B": None}]
+        ).encode("utf-8")
+
+
+def test_multiple_outputs_to_stdout_is_usage_error():
+    table = pyarrow.table({"A": ["a"]})
+    with parquet_file(table) as parquet_path:
+        for outputs in [["csv", "json"], ["csv:-", "json"]]:
+            completed = subprocess.run(
+                ["/usr/bin/parquet-to-text-stream", str(parquet_path), *outputs],
+                capture_output=True,
+            )
+            assert completed.returncode == 1
+            assert completed.stdout == b""
+            assert b"Only one output may be stdout" in completed.stderr
+
+
+def test_max_rows():
+    table = pyarrow.table({"A": ["a0", "a1", "a2", "a3", "a4"]})
+    with parquet_file(table, chunk_size=2) as parquet_path:
+        assert (
+            do_convert(
+                parquet_path, "csv", **{"--row-range": "1-5", "--max-rows": "2"}
+            )
+            == b"A\r\na1\r\na2"
+        )
+        assert do_convert(parquet_path, "json", **{"--max-rows": "0"}) == b"[]"
+
+
+def test_max_bytes():
+    table = pyarrow.table({"A": ["a0", "a1", "a2", "a3", "a4"]})
+    with parquet_file(table) as parquet_path:
+        # "A" + 3 * "\r\naN" = 13 bytes; the 4th record would make 17
+        assert (
+            do_convert(parquet_path, "csv", **{"--max-bytes": "16"})
+            == b"A\r\na0\r\na1\r\na2"
+        )
+        # '[{"A":"a0"}' is 11 bytes; each next record is 11; ']' is 1
+        assert (
+            do_convert(parquet_path, "json", **{"--max-bytes": "33"})
+            == b'[{"A":"a0"},{"A":"a1"}]'
+        )
+        # Headers are always written
+        assert do_convert(parquet_path, "json", **{"--max-bytes": "0"}) == b"[]"
+
+
+def test_stop_when_output_closes():
+    table = pyarrow.table({"A": pyarrow.array(range(1000000), pyarrow.int64())})
+    with parquet_file(table) as parquet_path:
+        process = subprocess.Popen(
+            ["/usr/bin/parquet-to-text-stream", str(parquet_path), "json"],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+        )
+        assert process.stdout.read(10) == b'[{"A":0},{'
+        process.stdout.close()
+        assert process.wait() == 141  # not killed by SIGPIPE
+        assert process.stderr.read() == b""
+
+
+def test_sort_by():
+    table = pyarrow.table(
+        {
+            "A": ["b", "a", None, "b", "a", "c"],
+            "B": pyarrow.array([1, 2, 3, None, -4, 5], pyarrow.int64()),
+            "C": [0.5, -1.0, 2.0, 3.5, -0.25, None],
+        }
+    )
+    with parquet_file(table, chunk_size=4) as parquet_path:
+        # ties keep file order; nulls sort last
+        assert (
+            do_convert(parquet_path, "csv", **{"--sort-by": "A"})
+            == b"A,B,C\r\na,2,-1\r\na,-4,-0.25\r\nb,1,0.5\r\nb,,3.5\r\nc,5,\r\n,3,2"
+        )
+        # ':desc' reverses one column (nulls first)
+        assert (
+            do_convert(parquet_path, "csv", **{"--sort-by": "A:desc,B"})
+            == b"A,B,C\r\n,3,2\r\nc,5,\r\nb,1,0.5\r\nb,,3.5\r\na,-4,-0.25\r\na,2,-1"
+        )
+        # sort key need not be output; --max-rows applies after sorting
+        assert do_convert(
+            parquet_path,
+            "json",
+            **{"--sort-by": "C", "--column-range": "0-1", "--max-rows": "3"},
+        ) == canonical_json([{"A": "a"}, {"A": "a"}, {"A": "b"}]).encode("utf-8")
+
+
+def test_sort_by_spills_to_disk():
+    table = pyarrow.table(
+        {"A": pyarrow.array([(i * 7919) % 1000 for i in range(1000)], pyarrow.int32())}
+    )
+    with parquet_file(table, chunk_size=300) as parquet_path:
+        # a tiny budget means one run per row, merged every 64 runs
+        assert do_convert(
+            parquet_path, "csv", **{"--sort-by": "A:desc", "--sort-memory": "1"}
+        ) == b"A\r\n" + b"\r\n".join(b"%d" % i for i in range(999, -1, -1))
+
+
+def test_prefetch_row_groups():
+    table = pyarrow.table(
+        {
+            "A": ["a0", "a1", "a2", "a3", "a4"],
+            "B": pyarrow.array([0, 1, None, 3, 4], pyarrow.int64()),
+        }
+    )
+    with parquet_file(table, chunk_size=2) as parquet_path:
+        for depth in ["0", "1", "3"]:
+            assert (
+                do_convert(
+                    parquet_path,
+                    "csv",
+                    **{"--prefetch-row-groups": depth, "--row-range": "1-5"},
+                )
+                == b"A,B\r\na1,1\r\na2,\r\na3,3\r\na4,4"
+            )
+        # A tiny memory cap means we never prefetch; output is the same
+        assert (
+            do_convert(parquet_path, "csv", **{"--prefetch-bytes": "1"})
+            == b"A,B\r\na0,0\r\na1,1\r\na2,\r\na3,3\r\na4,4"
+        )
+
+
+def test_reader_flags():
+    table = pyarrow.table({"A": pyarrow.array(range(1000), pyarrow.int64())})
+    expected = b"A\r\n" + b"\r\n".join(b"%d" % i for i in range(500, 1000))
+    with parquet_file(table, chunk_size=300, data_page_size=100) as parquet_path:
+        for flags in (
+            {"--buffered-stream": None, "--buffer-size": "64"},
+            {"--mmap": None},
+        ):
+            assert (
+                do_convert(parquet_path, "csv", **{"--row-range": "500-1000"}, **flags)
+                == expected
+            )
+
+
 # def test_convert_datetime_s():
 #     # Parquet has no "s" option like Arrow's.
 
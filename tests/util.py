@@ -61,9 +61,12 @@ def parquet_file(
     version="2.0",
     use_dictionary=False,
     chunk_size=None,
+    **kwargs,
 ) -> ContextManager[pathlib.Path]:
     """
     Yield a filename with `table` written to a Parquet file.
+
+    Extra `kwargs` are passed to `pyarrow.parquet.write_table()`.
     """
     with empty_file() as path:
         pyarrow.parquet.write_table(
@@ -73,5 +76,20 @@ def parquet_file(
             compression="SNAPPY",
             use_dictionary=use_dictionary,
             chunk_size=chunk_size,
+            **kwargs,
         )
         yield path
+
+
+@contextmanager
+def arrow_file(
+    table: pyarrow.Table, max_chunksize=None
+) -> ContextManager[pathlib.Path]:
+    """
+    Yield a filename with `table` written to an Arrow IPC file, in record
+    batches of up to `max_chunksize` rows.
+    """
+    with empty_file() as path:
+        with pyarrow.ipc.new_file(str(path), table.schema) as writer:
+            writer.write_table(table, max_chunksize=max_chunksize)
+        yield path